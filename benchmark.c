@@ -0,0 +1,445 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "sudoku.h"
+#include "include/killer.h"
+#include "include/easy_solve.h"
+#include "include/medium_solve.h"
+#include "include/transposition.h"
+#include "include/trace.h"
+#include "include/hard_solve.h"
+
+/*
+ * Program: SuDoku Killer
+ *
+ * Benchmark suite for the solver.  Every corpus is solved several times
+ * in process, every solution is checked against the known answer in
+ * boards/solutions, and the run times are summarised by their median and
+ * median absolute deviation.  Results can be saved as a baseline and a
+ * later run compared against it with a one sided Mann-Whitney U test.
+ *
+ */
+
+#define MAX_RUNS 25
+
+/* Slower than the baseline at this significance and by more than this fraction */
+#define REGRESSION_ALPHA	0.05
+#define REGRESSION_CHANGE	0.02
+
+/* One file of puzzles with its known answers and timings */
+typedef struct corpus {
+	char *name;
+	int count;
+	SuDoku *puzzles;
+	SuDoku *answers;
+	long nodes;
+	int wrong;
+	double times[MAX_RUNS];
+} corpus;
+
+char *default_corpora[] = {
+	"Top95", "Top91", "very_hard_1", "very_hard_2", "very_hard_3", "sudoku-diabolical", NULL
+};
+
+SuDoku bench_solution;
+int bench_solved;
+
+/******************************************************************************/
+void printUsage( ) {
+  printf ("\nUsage: sudoku-bench [-hm] [-L probes] [-H bits] [-r runs] [-w warmup] [-o file] [-c file] [corpus ...]\n");
+  printf ("	-h	Print this help message\n");
+  printf ("	-r runs	Timed runs of every corpus, default 5, at most %d\n", MAX_RUNS);
+  printf ("	-w runs	Untimed warmup runs of every corpus, default 1\n");
+  printf ("	-o file	Save the results as a baseline\n");
+  printf ("	-c file	Compare the results against a saved baseline\n");
+  printf ("	-m	Eliminate with number templates before every guess\n");
+  printf ("	-L probes	Probe up to probes candidates before every guess\n");
+  printf ("	-H bits	Prune boards already proven dead, in a table of 2^bits entries\n");
+  printf ("\n");
+  printf ("A corpus is a name such as Top95, read from boards/Top95.txt with\n");
+  printf ("known answers in boards/solutions/Top95.txt\n");
+  printf ("\n");
+}
+/******************************************************************************/
+
+/******************************************************************************/
+void benchSolution(SuDoku *board) {
+/******************************************************************************/
+  memcpy(&bench_solution, board, sizeof(SuDoku));
+  bench_solved = 1;
+}
+
+/******************************************************************************/
+int loadCorpusFile(char *fname, SuDoku **boards) {
+/******************************************************************************/
+  FILE *fin;
+  int count = 0, size = 16;
+
+  fin = fopen(fname, "rb");
+  if ( fin == NULL ) {
+    printf("Error: could not open '%s'\n", fname);
+    exit(1);
+  }
+
+  *boards = malloc(size * sizeof(SuDoku));
+  while (loadBenchmark(&(*boards)[count], fin) == 0) {
+    count++;
+    if (count == size) {
+      size *= 2;
+      *boards = realloc(*boards, size * sizeof(SuDoku));
+    }
+  }
+  fclose(fin);
+
+  return(count);
+}
+
+/******************************************************************************/
+void loadCorpus(corpus *c, char *name) {
+/******************************************************************************/
+  char fname[256];
+
+  c->name = name;
+  c->nodes = 0;
+  c->wrong = 0;
+
+  snprintf(fname, sizeof(fname), "boards/%s.txt", name);
+  c->count = loadCorpusFile(fname, &c->puzzles);
+
+  snprintf(fname, sizeof(fname), "boards/solutions/%s.txt", name);
+  if (loadCorpusFile(fname, &c->answers) != c->count) {
+    printf("Error: '%s' does not have one answer per puzzle\n", fname);
+    exit(1);
+  }
+}
+
+/******************************************************************************/
+double runCorpus(corpus *c) {
+/******************************************************************************/
+/*
+ * Solve every puzzle once, checking each answer.  Returns the seconds
+ * taken, not counting the answer checks.
+ *
+ */
+  SuDoku Board;
+  board_constraint Constraint;
+  search_state Search;
+  struct timeval start, end;
+  double total = 0;
+  int i, j, k;
+
+  c->nodes = 0;
+  c->wrong = 0;
+  clearDeadTable();
+  for (i=0; i<c->count; i++) {
+    memcpy(&Board, &c->puzzles[i], sizeof(SuDoku));
+    bench_solved = 0;
+
+    gettimeofday(&start, NULL);
+    resetSearch(&Search, 0, 0);
+    configureSearch(&Search, BRANCH_LEAST, VALUES_ASCENDING, 0, 0);
+    resetConstraint(&Constraint);
+    updateConstraint(&Board, &Constraint);
+    constraintPropagation(&Board, &Constraint, chooseMove(&Board, &Constraint, &Search), benchSolution, &Search);
+    gettimeofday(&end, NULL);
+
+    total += (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1000000.0;
+    c->nodes += Search.nodes;
+
+    if (bench_solved == 0) {
+      c->wrong++;
+      continue;
+    }
+    for (j=1; j<=9; j++) {
+      for (k=1; k<=9; k++) {
+        if (bench_solution.section[j].cell[k] != c->answers[i].section[j].cell[k]) {
+          j = 10;
+          c->wrong++;
+          break;
+        }
+      }
+    }
+  }
+
+  return(total);
+}
+
+/******************************************************************************/
+int compareDouble(const void *a, const void *b) {
+/******************************************************************************/
+  double x = *(const double *)a, y = *(const double *)b;
+
+  return((x > y) - (x < y));
+}
+
+/******************************************************************************/
+double median(double *values, int count) {
+/******************************************************************************/
+  double sorted[MAX_RUNS];
+
+  memcpy(sorted, values, count * sizeof(double));
+  qsort(sorted, count, sizeof(double), compareDouble);
+
+  if (count % 2 == 1) {
+    return(sorted[count/2]);
+  }
+  return((sorted[count/2 - 1] + sorted[count/2]) / 2);
+}
+
+/******************************************************************************/
+double medianDeviation(double *values, int count) {
+/******************************************************************************/
+  double deviation[MAX_RUNS], m;
+  int i;
+
+  m = median(values, count);
+  for (i=0; i<count; i++) {
+    deviation[i] = fabs(values[i] - m);
+  }
+  return(median(deviation, count));
+}
+
+/******************************************************************************/
+double mannWhitneyUpper(int m, int n, double u) {
+/******************************************************************************/
+/*
+ * Exact probability that U, the number of (x,y) pairs with x from a
+ * sample of m greater than y from a sample of n, is at least u when
+ * both samples come from one distribution.
+ *
+ * count[i][j][v] is the number of orderings of i x's and j y's with U = v,
+ * built by appending either the largest x (which beats all j y's) or the
+ * largest y.
+ *
+ */
+  double **count, total, tail;
+  int i, j, v;
+
+  count = malloc((m+1) * (n+1) * sizeof(double *));
+  for (i=0; i<=m; i++) {
+    for (j=0; j<=n; j++) {
+      count[i*(n+1) + j] = calloc(i*j + 1, sizeof(double));
+      for (v=0; v<=i*j; v++) {
+        if (i == 0 || j == 0) {
+          count[i*(n+1) + j][v] = (v == 0);
+          continue;
+        }
+        if (v >= j && v - j <= (i-1)*j) {
+          count[i*(n+1) + j][v] += count[(i-1)*(n+1) + j][v - j];
+        }
+        if (v <= i*(j-1)) {
+          count[i*(n+1) + j][v] += count[i*(n+1) + j-1][v];
+        }
+      }
+    }
+  }
+
+  total = 0;
+  tail = 0;
+  for (v=0; v<=m*n; v++) {
+    total += count[m*(n+1) + n][v];
+    if (v >= u) { tail += count[m*(n+1) + n][v]; }
+  }
+
+  for (i=0; i<(m+1)*(n+1); i++) {
+    free(count[i]);
+  }
+  free(count);
+
+  return(tail / total);
+}
+
+/******************************************************************************/
+int compareBaseline(char *fname, corpus *corpora, int corpus_count, int runs) {
+/******************************************************************************/
+/*
+ * Compare each corpus with the same corpus in a saved baseline.  Returns
+ * the number of significant regressions.
+ *
+ */
+  FILE *fin;
+  char line[1024], name[256], *p_line, *end;
+  double old_times[MAX_RUNS], old_median, new_median, change, p, u;
+  int old_runs, used, i, j, k, regressions = 0;
+
+  fin = fopen(fname, "r");
+  if ( fin == NULL ) {
+    printf("No baseline in '%s' to compare against\n", fname);
+    return(0);
+  }
+
+  printf("\nCompared with %s:\n", fname);
+  while (fgets(line, sizeof(line), fin) != NULL) {
+    if (line[0] == '#' || line[0] == '\n') { continue; }
+
+    if (sscanf(line, "%255s %d%n", name, &old_runs, &used) != 2 || old_runs < 1 || old_runs > MAX_RUNS) {
+      printf("Error: baseline '%s' corrupt\n", fname);
+      exit(1);
+    }
+    p_line = line + used;
+    for (j=0; j<old_runs; j++) {
+      old_times[j] = strtod(p_line, &end);
+      if (end == p_line) {
+        printf("Error: baseline '%s' corrupt\n", fname);
+        exit(1);
+      }
+      p_line = end;
+    }
+
+    for (i=0; i<corpus_count; i++) {
+      if (strcmp(name, corpora[i].name) != 0) { continue; }
+
+     /* U counts pairs where the new run was slower, ties count half */
+      u = 0;
+      for (j=0; j<runs; j++) {
+        for (k=0; k<old_runs; k++) {
+          if (corpora[i].times[j] > old_times[k]) { u += 1; }
+          else if (corpora[i].times[j] == old_times[k]) { u += 0.5; }
+        }
+      }
+      p = mannWhitneyUpper(runs, old_runs, ceil(u));
+
+      old_median = median(old_times, old_runs);
+      new_median = median(corpora[i].times, runs);
+      change = (new_median - old_median) / old_median;
+
+      printf("  %-20s %9.4f -> %9.4f sec  %+6.1f%%  p=%.3f", name, old_median, new_median, change * 100, p);
+      if (p < REGRESSION_ALPHA && change > REGRESSION_CHANGE) {
+        printf("  REGRESSION");
+        regressions++;
+      } else if (1 - p < REGRESSION_ALPHA && change < -REGRESSION_CHANGE) {
+        printf("  improved");
+      }
+      printf("\n");
+    }
+  }
+  fclose(fin);
+
+  return(regressions);
+}
+
+/******************************************************************************/
+void saveBaseline(char *fname, corpus *corpora, int corpus_count, int runs) {
+/******************************************************************************/
+  FILE *fout;
+  int i, j;
+
+  fout = fopen(fname, "w");
+  if ( fout == NULL ) {
+    printf("Error: could not open '%s'\n", fname);
+    exit(1);
+  }
+
+  fprintf(fout, "# corpus runs seconds...\n");
+  for (i=0; i<corpus_count; i++) {
+    fprintf(fout, "%s %d", corpora[i].name, runs);
+    for (j=0; j<runs; j++) {
+      fprintf(fout, " %.6f", corpora[i].times[j]);
+    }
+    fprintf(fout, "\n");
+  }
+  fclose(fout);
+}
+
+/******************************************************************************/
+int main (int argc, char *argv[]) {
+/******************************************************************************/
+  corpus *corpora;
+  char **names;
+  char *save_file = NULL, *compare_file = NULL;
+  int runs = 5, warmup = 1;
+  double low, high;
+  int corpus_count, i, j, opt, failed = 0;
+
+  while ((opt = getopt(argc, argv, ":hmL:H:r:w:o:c:")) != -1) {
+    switch(opt) {
+      case 'h':
+        printUsage();
+        exit(0);
+
+      case 'm':
+      case 'L':
+      case 'H':
+        searchOption(opt, optarg);
+        break;
+
+      case 'r':
+        runs = atoi(optarg);
+        break;
+
+      case 'w':
+        warmup = atoi(optarg);
+        break;
+
+      case 'o':
+        save_file = optarg;
+        break;
+
+      case 'c':
+        compare_file = optarg;
+        break;
+    }
+  }
+
+  if (runs < 1 || runs > MAX_RUNS) {
+    printf("Error: runs must be between 1 and %d\n", MAX_RUNS);
+    exit(1);
+  }
+
+  if (optind < argc) {
+    names = &argv[optind];
+    corpus_count = argc - optind;
+  } else {
+    names = default_corpora;
+    for (corpus_count=0; names[corpus_count] != NULL; corpus_count++);
+  }
+
+  corpora = malloc(corpus_count * sizeof(corpus));
+  printf("%-20s %7s %10s %10s %10s %10s %10s\n", "corpus", "puzzles", "nodes", "median", "mad", "min", "max");
+  for (i=0; i<corpus_count; i++) {
+    loadCorpus(&corpora[i], names[i]);
+
+    for (j=0; j<warmup; j++) {
+      runCorpus(&corpora[i]);
+    }
+    for (j=0; j<runs; j++) {
+      corpora[i].times[j] = runCorpus(&corpora[i]);
+      if (corpora[i].wrong != 0) {
+        printf("Error: %d wrong answers in %s\n", corpora[i].wrong, corpora[i].name);
+        failed = 1;
+        break;
+      }
+    }
+
+    if (corpora[i].wrong != 0) { continue; }
+
+    low = corpora[i].times[0];
+    high = corpora[i].times[0];
+    for (j=1; j<runs; j++) {
+      if (corpora[i].times[j] < low) { low = corpora[i].times[j]; }
+      if (corpora[i].times[j] > high) { high = corpora[i].times[j]; }
+    }
+    printf("%-20s %7d %10ld %10.4f %10.4f %10.4f %10.4f\n", corpora[i].name, corpora[i].count, corpora[i].nodes,
+        median(corpora[i].times, runs), medianDeviation(corpora[i].times, runs), low, high);
+  }
+
+  if (failed != 0) {
+    exit(failed);
+  }
+  if (compare_file != NULL && compareBaseline(compare_file, corpora, corpus_count, runs) != 0) {
+    failed = 1;
+  }
+  if (save_file != NULL) {
+    saveBaseline(save_file, corpora, corpus_count, runs);
+  }
+
+  exit(failed);
+}
@@ -0,0 +1,266 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Per puzzle strategy selection.  Which heuristics pay off depends on the
+ * puzzle, so each puzzle is sorted into a bucket by three cheap features
+ * and searched with the strategy a calibration run found fastest for
+ * that bucket:
+ *
+ *   clues      how many cells are given (up to 21, 22 to 25, 26 and up)
+ *   progress   how many cells scanBoard fills in before it stalls (up to
+ *              4, 5 to 19, 20 and up, or the whole board)
+ *   spread     how many rows, columns and sections hold at most one clue
+ *              (none, 1 to 3, 4 and up)
+ *
+ * A strategy sets the cell heuristic and value order of the search and
+ * the global number templates (-m) and probing (-L) switches.  Strategy
+ * 0 is the plain search, which buckets without an entry fall back to.
+ *
+ * The table file holds one line per bucket, "bucket strategy", and
+ * comment lines starting with '#'.
+ *
+ * loadStrategyTable
+ * -----------------
+ * Read a table written by calibrateStrategies.  Exits if it cannot be
+ * read.
+ *
+ * boardStrategy
+ * -------------
+ * The strategy the loaded table gives a board, 0 without a table.  Batch
+ * runs take it before triage, since the table was calibrated on the
+ * puzzles as they were given, not as far as propagation gets them.
+ *
+ * adaptSearch
+ * -----------
+ * Configure a search, and the template and probe switches, for a board
+ * from the loaded table.  Returns the strategy.
+ *
+ * calibrateStrategies
+ * -------------------
+ * Search every puzzle with every strategy, report the fastest strategy of
+ * each bucket and write them to a table file.  A strategy has to beat
+ * the plain search by a tenth to be chosen.  Every run after the plain
+ * one is cut off at CALIBRATE_FACTOR times its time, so a strategy that
+ * blows up on a puzzle costs only a bounded amount of calibration time.
+ *
+ */
+
+#define STRATEGIES	16
+#define STRATEGY_BUCKETS	36
+#define STRATEGY_PROBES	8
+#define CALIBRATE_FACTOR	4
+
+typedef struct strategy {
+	int branch;
+	int values;
+	int templates;
+	int probes;
+} strategy;
+
+/* Every mix of cell heuristic, value order, templates and probing */
+strategy strategies[STRATEGIES] = {
+	{ BRANCH_LEAST, VALUES_ASCENDING,  0, 0 },
+	{ BRANCH_LEAST, VALUES_DESCENDING, 0, 0 },
+	{ BRANCH_MOST,  VALUES_ASCENDING,  0, 0 },
+	{ BRANCH_MOST,  VALUES_DESCENDING, 0, 0 },
+	{ BRANCH_LEAST, VALUES_ASCENDING,  1, 0 },
+	{ BRANCH_LEAST, VALUES_DESCENDING, 1, 0 },
+	{ BRANCH_MOST,  VALUES_ASCENDING,  1, 0 },
+	{ BRANCH_MOST,  VALUES_DESCENDING, 1, 0 },
+	{ BRANCH_LEAST, VALUES_ASCENDING,  0, STRATEGY_PROBES },
+	{ BRANCH_LEAST, VALUES_DESCENDING, 0, STRATEGY_PROBES },
+	{ BRANCH_MOST,  VALUES_ASCENDING,  0, STRATEGY_PROBES },
+	{ BRANCH_MOST,  VALUES_DESCENDING, 0, STRATEGY_PROBES },
+	{ BRANCH_LEAST, VALUES_ASCENDING,  1, STRATEGY_PROBES },
+	{ BRANCH_LEAST, VALUES_DESCENDING, 1, STRATEGY_PROBES },
+	{ BRANCH_MOST,  VALUES_ASCENDING,  1, STRATEGY_PROBES },
+	{ BRANCH_MOST,  VALUES_DESCENDING, 1, STRATEGY_PROBES }
+};
+
+int strategy_table[STRATEGY_BUCKETS];
+int adaptive = 0;
+
+SuDoku calibrate_solution;
+
+int strategyBucket (SuDoku*);
+void loadStrategyTable (char*);
+int boardStrategy (SuDoku*);
+int adaptSearch (SuDoku*, search_state*);
+void calibrateStrategies (FILE*, char*, search_state*);
+
+void describeStrategy (int s, char *text, int size) {
+  snprintf(text, size, "%s %s%s%s", (strategies[s].branch == BRANCH_MOST) ? "most" : "least",
+      (strategies[s].values == VALUES_DESCENDING) ? "descending" : "ascending",
+      (strategies[s].templates != 0) ? " templates" : "", (strategies[s].probes != 0) ? " probes" : "");
+}
+
+int strategyBucket (SuDoku *board) {
+  SuDoku scanned;
+  board_constraint Constraint;
+  int clues = 0, filled = 0, sparse = 0, in_unit;
+  int clue_bucket, progress_bucket, spread_bucket;
+  int i,j,u;
+
+  if (unit_count == 0) { loadUnits(); }
+
+  for (i=1; i<=9; i++) {
+    for (j=1; j<=9; j++) {
+      if (board->section[i].cell[j] != 0) { clues++; }
+    }
+  }
+  for (u=0; u<unit_count; u++) {
+    in_unit = 0;
+    for (j=0; j<9; j++) {
+      if (board->section[ units[u][j].section ].cell[ units[u][j].cell ] != 0) { in_unit++; }
+    }
+    if (in_unit <= 1) { sparse++; }
+  }
+
+  memcpy(&scanned, board, sizeof(SuDoku));
+  resetConstraint(&Constraint);
+  updateConstraint(&scanned, &Constraint);
+  if (scanBoard(&scanned, &Constraint) == 0) {
+    filled = 81;
+  } else {
+    for (i=1; i<=9; i++) {
+      for (j=1; j<=9; j++) {
+        if (scanned.section[i].cell[j] != 0) { filled++; }
+      }
+    }
+  }
+
+  clue_bucket = (clues <= 21) ? 0 : (clues <= 25) ? 1 : 2;
+  if (filled == 81) {
+    progress_bucket = 3;
+  } else {
+    progress_bucket = (filled - clues <= 4) ? 0 : (filled - clues <= 19) ? 1 : 2;
+  }
+  spread_bucket = (sparse == 0) ? 0 : (sparse <= 3) ? 1 : 2;
+
+  return((clue_bucket * 4 + progress_bucket) * 3 + spread_bucket);
+}
+
+void loadStrategyTable (char *fname) {
+  FILE *fin;
+  char line[256];
+  int bucket, s;
+
+  memset(strategy_table, 0, sizeof(strategy_table));
+  fin = fopen(fname, "r");
+  if (fin == NULL) {
+    printf("Error: could not open strategy table '%s'\n", fname);
+    exit(1);
+  }
+  while (fgets(line, sizeof(line), fin) != NULL) {
+    if (line[0] == '#' || sscanf(line, "%d %d", &bucket, &s) != 2) { continue; }
+    if (bucket < 0 || bucket >= STRATEGY_BUCKETS || s < 0 || s >= STRATEGIES) {
+      printf("Error: bad strategy line '%s' in '%s'\n", strtok(line, "\r\n"), fname);
+      exit(1);
+    }
+    strategy_table[bucket] = s;
+    if (strategies[s].templates != 0) { loadTemplates(); }	/* once, before -b forks */
+  }
+  fclose(fin);
+  adaptive = 1;
+}
+
+void applyStrategy (search_state *search, int s) {
+  configureSearch(search, strategies[s].branch, strategies[s].values, 0, 0);
+  use_templates = strategies[s].templates;
+  probe_limit = strategies[s].probes;
+}
+
+int boardStrategy (SuDoku *board) {
+  if (adaptive == 0) { return(0); }
+  return(strategy_table[ strategyBucket(board) ]);
+}
+
+int adaptSearch (SuDoku *board, search_state *search) {
+  int s;
+
+  s = boardStrategy(board);
+  applyStrategy(search, s);
+  return(s);
+}
+
+void calibrateFunc (SuDoku *board) {
+  memcpy(&calibrate_solution, board, sizeof(SuDoku));
+}
+
+long calibrateRun (SuDoku *board, search_state *limits, int s, long cutoff) {
+/*
+ * Microseconds strategy s takes on a board, within cutoff milliseconds
+ * if that is not zero.
+ *
+ */
+
+  SuDoku newBoard;
+  board_constraint Constraint;
+  search_state search;
+  struct timeval start, end;
+  long time_limit = limits->time_limit;
+
+  if (cutoff != 0 && (time_limit == 0 || cutoff < time_limit)) { time_limit = cutoff; }
+
+  memcpy(&newBoard, board, sizeof(SuDoku));
+  gettimeofday(&start, NULL);
+  resetSearch(&search, limits->node_limit, time_limit);
+  applyStrategy(&search, s);
+  resetConstraint(&Constraint);
+  updateConstraint(&newBoard, &Constraint);
+  constraintPropagation(&newBoard, &Constraint, chooseMove(&newBoard, &Constraint, &search), calibrateFunc, &search);
+  gettimeofday(&end, NULL);
+
+  return((end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec);
+}
+
+void calibrateStrategies (FILE *fin, char *fname, search_state *limits) {
+  SuDoku board;
+  FILE *fout;
+  char text[64];
+  double cost[STRATEGY_BUCKETS][STRATEGIES];
+  int puzzles[STRATEGY_BUCKETS];
+  int bucket, s, best, count = 0;
+  long plain;
+
+  memset(cost, 0, sizeof(cost));
+  memset(puzzles, 0, sizeof(puzzles));
+  loadTemplates();
+
+  while (loadBenchmark(&board, fin) == 0) {
+    bucket = strategyBucket(&board);
+    puzzles[bucket]++;
+    count++;
+
+    plain = calibrateRun(&board, limits, 0, 0);
+    cost[bucket][0] += plain;
+    for (s=1; s<STRATEGIES; s++) {
+      cost[bucket][s] += calibrateRun(&board, limits, s, CALIBRATE_FACTOR * plain / 1000 + 1);
+    }
+  }
+
+  fout = fopen(fname, "w");
+  if (fout == NULL) {
+    printf("Error: could not write strategy table '%s'\n", fname);
+    exit(1);
+  }
+  fprintf(fout, "# bucket strategy, calibrated on %d puzzles\n", count);
+
+  printf("%-8s %8s  %-32s %12s %12s\n", "bucket", "puzzles", "fastest strategy", "usec", "plain usec");
+  for (bucket=0; bucket<STRATEGY_BUCKETS; bucket++) {
+    if (puzzles[bucket] == 0) { continue; }
+
+   /* Timing noise is not worth leaving the plain search for */
+    best = 0;
+    for (s=1; s<STRATEGIES; s++) {
+      if (cost[bucket][s] < cost[bucket][best] && cost[bucket][s] < cost[bucket][0] * 0.9) { best = s; }
+    }
+    describeStrategy(best, text, sizeof(text));
+    printf("%-8d %8d  %2d %-29s %12.0f %12.0f\n", bucket, puzzles[bucket], best, text, cost[bucket][best], cost[bucket][0]);
+    fprintf(fout, "%d %d\n", bucket, best);
+  }
+  fclose(fout);
+
+  use_templates = 0;
+  probe_limit = 0;
+}
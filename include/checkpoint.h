@@ -0,0 +1,75 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Checkpoints of long benchmark runs.  A checkpoint records how far into
+ * the input file the run has read, how much output it has written for
+ * those puzzles, and the counts and time so far, so a run that dies can
+ * pick up where the last checkpoint left it.  The file is small text:
+ *
+ *   sudoku checkpoint 1
+ *   input 123456
+ *   output 234567
+ *   puzzles 1500
+ *   lanes 0
+ *   usec 81234567
+ *
+ * writeCheckpoint
+ * ---------------
+ * Write a checkpoint to a new file and rename it over the old one, so a
+ * crash while writing leaves the previous checkpoint whole.
+ *
+ * readCheckpoint
+ * --------------
+ * Read a checkpoint.  Returns 0 on success, 1 if the file is missing or
+ * not a checkpoint.
+ *
+ */
+
+#define CHECKPOINT_VERSION	1
+#define CHECKPOINT_MSEC		1000	/* least time between two checkpoints */
+
+typedef struct checkpoint {
+	long input;		/* offset of the next puzzle to solve */
+	long output;		/* length of the output of the puzzles before it */
+	long puzzles;
+	long lane_solved;
+	long usec;		/* run time so far */
+} checkpoint;
+
+int writeCheckpoint (char*, checkpoint*);
+int readCheckpoint (char*, checkpoint*);
+
+int writeCheckpoint (char *fname, checkpoint *ck) {
+  char tmpname[1024];
+  FILE *fout;
+
+  snprintf(tmpname, sizeof(tmpname), "%s.tmp", fname);
+  fout = fopen(tmpname, "w");
+  if (fout == NULL) {
+    return(1);
+  }
+  fprintf(fout, "sudoku checkpoint %d\n", CHECKPOINT_VERSION);
+  fprintf(fout, "input %ld\noutput %ld\npuzzles %ld\nlanes %ld\nusec %ld\n", ck->input, ck->output, ck->puzzles, ck->lane_solved, ck->usec);
+  if (fflush(fout) != 0 || fsync(fileno(fout)) != 0) {
+    fclose(fout);
+    return(1);
+  }
+  fclose(fout);
+
+  return(rename(tmpname, fname) != 0);
+}
+
+int readCheckpoint (char *fname, checkpoint *ck) {
+  FILE *fin;
+  int version, fields;
+
+  fin = fopen(fname, "r");
+  if (fin == NULL) {
+    return(1);
+  }
+  fields = fscanf(fin, "sudoku checkpoint %d input %ld output %ld puzzles %ld lanes %ld usec %ld",
+      &version, &ck->input, &ck->output, &ck->puzzles, &ck->lane_solved, &ck->usec);
+  fclose(fin);
+
+  return(fields != 6 || version != CHECKPOINT_VERSION);
+}
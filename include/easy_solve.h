@@ -33,35 +33,24 @@ int scanBoard (SuDoku *board, board_constraint *constraint) {
 
     if (move.value == 0) { return(1); }
 
-    board->section[ move.section ].cell[ move.cell ] = move.value;
+    placeValue(board, move.section, move.cell, move.value);
   }
 
   return(0);
 }
 
 c_address findConstrainedMove (board_constraint *constraint) {
-  int i,j,k;
-  int section_count;
+  int k;
   c_address theMove;
 
-  for (i=1; i<=9; i++) {
-    for (j=1; j<=9; j++) {
-      section_count = 0;
-      for (k=1; k<=9; k++) {
-        if (constraint->section[i].cell[j].value[k] == 1) {
-          theMove.section = i;
-          theMove.cell = j;
-          theMove.value = k;
-
-          section_count++;
-        }
-      }
-      if (section_count == 1) { return(theMove); }
-    }
+  theMove.value = 0;
+  if (bucketCell(NULL, constraint, 1, &theMove) != 0) {
+    for (k=1; constraint->section[theMove.section].cell[theMove.cell].value[k] == 0; k++);
+    theMove.value = k;
+    return(theMove);
   }
 
   theMove.section = 0;
   theMove.cell = 0;
-  theMove.value = 0;
   return(theMove);
 }
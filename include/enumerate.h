@@ -0,0 +1,350 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Enumeration of every solution of a board, one at a time.
+ *
+ * An iterator keeps its search on an explicit stack instead of the call
+ * stack, one frame per guess holding the propagated board, the cell being
+ * guessed and the last value tried there.  iteratorNext runs the search
+ * only until the next solution and returns it, so the caller pulls
+ * solutions as it wants them and can stop or pause between any two.  The
+ * stack never holds more than one frame per open cell, however many
+ * solutions there are.
+ *
+ * Guessing the different values of one cell splits the solutions into
+ * disjoint sets, so no solution is ever found twice, within one iterator
+ * or between iterators started on the subtrees of enumerateSplit.
+ *
+ * With -H a board whose subtree held no solution is recorded in the dead
+ * board table (see include/transposition.h), and is skipped when any
+ * iterator or thread reaches it again.  An iterator started with a
+ * narrowed constraint leaves the table alone, since a board dead under
+ * that constraint may still have solutions.
+ *
+ * iteratorStart
+ * -------------
+ * Start enumerating the solutions of a board.
+ *
+ * iteratorStartWith
+ * -----------------
+ * Start enumerating with a constraint the caller has already narrowed,
+ * for solutions that must also keep to it.
+ *
+ * iteratorNext
+ * ------------
+ * Search for the next solution and copy it onto solution.  Returns 1 if
+ * there was one, 0 once every solution has been returned.
+ *
+ * iteratorCount
+ * -------------
+ * Count the remaining solutions without copying them out, stopping at
+ * limit if it is not zero.
+ *
+ * enumerateSplit
+ * --------------
+ * Split a board into at least count subtrees, boards with some guesses
+ * placed, by guessing breadth first.  Solutions found while splitting are
+ * passed to the handler.  Returns the number of subtrees in a new array.
+ *
+ * enumerateParallel
+ * -----------------
+ * Enumerate the solutions of a board on threads threads, each pulling
+ * subtrees from enumerateSplit.  Every solution is passed to the handler
+ * as it is found, with the calls serialized.  A NULL handler only counts
+ * them, with iteratorCount.  Returns the number of solutions.
+ *
+ */
+
+#define ENUM_SPLIT	16	/* subtrees per thread */
+
+typedef struct enum_frame {
+	SuDoku board;
+	board_constraint constraint;
+	c_address cell;		/* the cell guessed here and the last value tried */
+	unsigned long long hash;	/* of the board before propagation */
+	long solutions;		/* found before this frame was pushed */
+} enum_frame;
+
+typedef struct solution_iterator {
+	enum_frame stack[82];
+	int depth;
+	int pending;		/* the start board was solved by propagation alone */
+	int prune;		/* read and record the dead board table */
+	long nodes;
+	long solutions;
+} solution_iterator;
+
+/* Subtrees shared by the threads of enumerateParallel */
+typedef struct enum_work {
+	SuDoku *subtrees;
+	int count;
+	int next;
+	long solutions;
+	handler_func handler;
+	pthread_mutex_t lock;
+} enum_work;
+
+void iteratorStart (solution_iterator*, SuDoku*);
+void iteratorStartWith (solution_iterator*, SuDoku*, board_constraint*);
+int iteratorNext (solution_iterator*, SuDoku*);
+long iteratorCount (solution_iterator*, long);
+int enumerateSplit (SuDoku*, int, SuDoku**, handler_func);
+long enumerateParallel (SuDoku*, int, handler_func);
+
+int enumeratePropagate (SuDoku *board, board_constraint *constraint) {
+/*
+ * Place everything propagation proves.  Returns 0 if that solves the
+ * board, 1 if it is still open and 2 if a rule is broken.
+ *
+ */
+
+  if (scanBoard(board, constraint) == 0) {
+    return(checkRules(board) == 0 ? 0 : 2);
+  }
+  updateConstraint(board, constraint);
+  if (checkRules(board) != 0 || checkConstraintRules(board, constraint) != 0) {
+    return(2);
+  }
+  return(1);
+}
+
+int iteratorPush (solution_iterator *iterator, SuDoku *board, board_constraint *constraint) {
+/*
+ * Propagate a board and push it as a new frame.  Returns 0 if the board
+ * is solved instead (it is left on the frame above the top), 1 if it
+ * was pushed and 2 if it is dead.
+ *
+ */
+
+  enum_frame *frame = &iterator->stack[iterator->depth];
+  int result;
+
+  if (board != &frame->board) {
+    memcpy(&frame->board, board, sizeof(SuDoku));
+    memcpy(&frame->constraint, constraint, sizeof(board_constraint));
+  }
+  iterator->nodes++;
+
+  frame->hash = frame->board.hash;
+  frame->solutions = iterator->solutions;
+  if (iterator->prune != 0 && deadState(frame->hash) != 0) {
+    return(2);
+  }
+
+  result = enumeratePropagate(&frame->board, &frame->constraint);
+  if (result == 1 && iterator->prune != 0 && deadState(frame->board.hash) != 0) {
+    return(2);
+  }
+  if (result == 1) {
+    frame->cell = findLeastConstrained(&frame->board, &frame->constraint);
+    if (frame->cell.section == 0) { result = 2; }
+  }
+  if (result != 1) {
+    if (result == 2 && iterator->prune != 0) {
+      recordDead(frame->hash);
+      recordDead(frame->board.hash);
+    }
+    return(result);
+  }
+
+  frame->cell.value = 0;
+  iterator->depth++;
+  return(1);
+}
+
+void iteratorBegin (solution_iterator *iterator, SuDoku *board, board_constraint *constraint, int prune) {
+  iterator->depth = 0;
+  iterator->pending = 0;
+  iterator->prune = prune;
+  iterator->nodes = 0;
+  iterator->solutions = 0;
+
+  if (iteratorPush(iterator, board, constraint) == 0) {
+    iterator->pending = 1;
+  }
+}
+
+void iteratorStartWith (solution_iterator *iterator, SuDoku *board, board_constraint *constraint) {
+  iteratorBegin(iterator, board, constraint, 0);
+}
+
+void iteratorStart (solution_iterator *iterator, SuDoku *board) {
+  board_constraint Constraint;
+
+  resetConstraint(&Constraint);
+  updateConstraint(board, &Constraint);
+  iteratorBegin(iterator, board, &Constraint, 1);
+}
+
+int iteratorStep (solution_iterator *iterator) {
+/*
+ * Run the search to the next solution, which is left on the frame above
+ * the top of the stack.  Returns 1 if there was one, 0 if not.
+ *
+ */
+
+  enum_frame *frame, *child;
+  int k;
+
+  if (iterator->pending != 0) {
+    iterator->pending = 0;
+    iterator->solutions++;
+    return(1);
+  }
+
+  while (iterator->depth > 0) {
+    frame = &iterator->stack[iterator->depth - 1];
+
+    for (k=frame->cell.value + 1; k<=9; k++) {
+      if (frame->constraint.section[ frame->cell.section ].cell[ frame->cell.cell ].value[k] == 1) { break; }
+    }
+    if (k > 9) {		/* every value of the cell was tried */
+      if (iterator->prune != 0 && iterator->solutions == frame->solutions) {
+        recordDead(frame->hash);
+        recordDead(frame->board.hash);
+      }
+      iterator->depth--;
+      continue;
+    }
+    frame->cell.value = k;
+
+    child = &iterator->stack[iterator->depth];
+    memcpy(&child->board, &frame->board, sizeof(SuDoku));
+    memcpy(&child->constraint, &frame->constraint, sizeof(board_constraint));
+    placeValue(&child->board, frame->cell.section, frame->cell.cell, k);
+
+    if (iteratorPush(iterator, &child->board, &child->constraint) == 0) {
+      iterator->solutions++;
+      return(1);
+    }
+  }
+
+  return(0);
+}
+
+int iteratorNext (solution_iterator *iterator, SuDoku *solution) {
+  if (iteratorStep(iterator) == 0) {
+    return(0);
+  }
+  memcpy(solution, &iterator->stack[iterator->depth].board, sizeof(SuDoku));
+  return(1);
+}
+
+long iteratorCount (solution_iterator *iterator, long limit) {
+  long count = 0;
+
+  while ((limit == 0 || count < limit) && iteratorStep(iterator) != 0) {
+    count++;
+  }
+  return(count);
+}
+
+int enumerateSplit (SuDoku *board, int count, SuDoku **subtrees, handler_func handler) {
+  SuDoku *queue, newBoard;
+  board_constraint Constraint;
+  c_address cell;
+  int head = 0, tail = 0, size = count * 9 + 9, k;
+
+  queue = malloc(size * sizeof(SuDoku));
+  memcpy(&queue[tail++], board, sizeof(SuDoku));
+
+ /* Replace the oldest subtree by one subtree per candidate of its best cell */
+  while (tail - head > 0 && tail - head < count) {
+    memcpy(&newBoard, &queue[head++], sizeof(SuDoku));
+    resetConstraint(&Constraint);
+    updateConstraint(&newBoard, &Constraint);
+
+    switch (enumeratePropagate(&newBoard, &Constraint)) {
+      case 0:
+        handler(&newBoard);
+        continue;
+      case 2:
+        continue;
+    }
+
+    cell = findLeastConstrained(&newBoard, &Constraint);
+    if (cell.section == 0) { continue; }
+
+    if (tail + 9 > size) {		/* slide the live subtrees back to the front */
+      memmove(&queue[0], &queue[head], (tail - head) * sizeof(SuDoku));
+      tail -= head;
+      head = 0;
+    }
+    for (k=1; k<=9; k++) {
+      if (Constraint.section[cell.section].cell[cell.cell].value[k] == 1) {
+        memcpy(&queue[tail], &newBoard, sizeof(SuDoku));
+        placeValue(&queue[tail], cell.section, cell.cell, k);
+        tail++;
+      }
+    }
+  }
+
+  memmove(&queue[0], &queue[head], (tail - head) * sizeof(SuDoku));
+  *subtrees = queue;
+  return(tail - head);
+}
+
+void *enumerateWorker (void *threadarg) {
+  enum_work *work = (enum_work *) threadarg;
+  solution_iterator *iterator;
+  SuDoku solution;
+  int subtree;
+
+  iterator = malloc(sizeof(solution_iterator));
+  while ((subtree = __sync_fetch_and_add(&work->next, 1)) < work->count) {
+    iteratorStart(iterator, &work->subtrees[subtree]);
+    if (work->handler == NULL) {
+      __sync_add_and_fetch(&work->solutions, iteratorCount(iterator, 0));
+      continue;
+    }
+    while (iteratorNext(iterator, &solution) != 0) {
+      pthread_mutex_lock(&work->lock);
+      work->solutions++;
+      work->handler(&solution);
+      pthread_mutex_unlock(&work->lock);
+    }
+  }
+  free(iterator);
+  return NULL;
+}
+
+/* Solutions found while splitting, counted for enumerateParallel */
+handler_func enum_split_handler;
+long enum_split_solutions;
+
+void enumerateSplitFunc (SuDoku *board) {
+  enum_split_solutions++;
+  if (enum_split_handler != NULL) {
+    enum_split_handler(board);
+  }
+}
+
+long enumerateParallel (SuDoku *board, int threads, handler_func handler) {
+  enum_work work;
+  pthread_t *thread;
+  int i;
+
+  enum_split_handler = handler;
+  enum_split_solutions = 0;
+  work.count = enumerateSplit(board, threads * ENUM_SPLIT, &work.subtrees, enumerateSplitFunc);
+  work.next = 0;
+  work.solutions = enum_split_solutions;
+  work.handler = handler;
+  pthread_mutex_init(&work.lock, NULL);
+
+  thread = malloc(threads * sizeof(pthread_t));
+  for (i=0; i<threads; i++) {
+    if (pthread_create(&thread[i], NULL, enumerateWorker, &work) != 0) {
+      printf("Error: could not start enumeration thread %d\n", i);
+      exit(1);
+    }
+  }
+  for (i=0; i<threads; i++) {
+    pthread_join(thread[i], NULL);
+  }
+
+  pthread_mutex_destroy(&work.lock);
+  free(thread);
+  free(work.subtrees);
+  return(work.solutions);
+}
@@ -3,21 +3,381 @@
  *
  * Functions for hard and very hard difficulty solving methods of the SuDoku puzzles.
  *
+ * constraintPropagation
+ * ---------------------
+ * Brute force the board one constrained guess at a time.  Returns
+ * SEARCH_SOLVED once the solution handler has been called, SEARCH_ABORTED
+ * if the search budget ran out, and SEARCH_CONTINUE if the branch is dead.
+ * Boards proven dead are kept in the transposition table, if there is one,
+ * and pruned when they are reached again.
+ *
+ * Every dead end comes with the set of earlier guesses it follows from,
+ * gathered from the reasons propagation recorded for the candidates it
+ * removed (see dropCandidate), and a dead branch leaves that set in
+ * constraint->conflict.  When a value of a cell fails for reasons that do
+ * not include the guess at the cell itself, every other value would fail
+ * the same way, so the rest are skipped and the search backs up to the
+ * latest guess that was involved.
+ *
+ * resetSearch
+ * -----------
+ * Start a new search budget.  A limit of zero means unlimited.
+ *
+ * searchExpired
+ * -------------
+ * Count one search node and test it against the budget.  Every thread
+ * searching the same puzzle shares one budget.
+ *
+ * configureSearch
+ * ---------------
+ * Choose the heuristics of a search: which cell to guess at (BRANCH_),
+ * the order its candidates are tried in (VALUES_), and whether ties
+ * between equally constrained cells are broken at random.  The seed
+ * drives both random choices.  resetSearch leaves the configuration alone.
+ *
+ * chooseMove
+ * ----------
+ * The cell and first value to guess next, by the configured heuristics.
+ *
+ * nextValue
+ * ---------
+ * The next candidate to try for the cell of curCell, by the configured
+ * value order.  Returns section 0 when the cell has no more candidates.
+ *
+ * probeCandidates
+ * ---------------
+ * Failed literal probing.  Cells with two or three candidates, fewest
+ * first, have each candidate tried on a copy of the board.  A candidate
+ * that scanBoard and checkConstraintRules prove broken is removed, and
+ * a cell that has the same value in every surviving copy is placed.  At
+ * most probe_limit candidates are tried.  Returns 0 if the board is
+ * solved, 1 if it is still open and 2 if no candidate of a cell survived.
+ *
+ * searchOption
+ * ------------
+ * Set up one of the search modes sudoku and sudoku-bench both take: -m
+ * templates, -L probes and -H the dead board table, so the benchmark
+ * runs every mode exactly as the solver does.  Returns 0 if opt is one
+ * of them, 1 if not.
  *
  */
 
+#define SEARCH_CONTINUE	0
+#define SEARCH_SOLVED	1
+#define SEARCH_ABORTED	2
+
+#define BRANCH_LEAST	0	/* fewest candidates, findLeastConstrained */
+#define BRANCH_MOST	1	/* most candidates, findMostConstrained */
+
+#define VALUES_ASCENDING	0
+#define VALUES_DESCENDING	1
+#define VALUES_RANDOM		2
+
+#define PROBE_CANDIDATES	3
+
+/* Candidates probeCandidates may try before each guess, 0 to not probe */
+int probe_limit = 0;
+
 typedef void (*handler_func)(SuDoku*);
 
+/* Limits and running statistics for the search of one puzzle */
+typedef struct search_state {
+	long node_limit;		/* nodes, 0 for unlimited */
+	long time_limit;		/* milliseconds, 0 for unlimited */
+	struct timeval start;
+	long nodes;
+	long dead_ends;
+	long backjumps;			/* values skipped by jumping back over a guess */
+	volatile int aborted;
+	int branch;
+	int values;
+	int random_ties;
+	unsigned int seed;
+} search_state;
+
 c_address findLeastConstrained (SuDoku*, board_constraint*);
+c_address findMostConstrained (SuDoku*, board_constraint*);
 c_address nextConstraint (board_constraint*, c_address);
+c_address chooseMove (SuDoku*, board_constraint*, search_state*);
+c_address nextValue (board_constraint*, c_address, search_state*);
+int searchExpired (search_state*);
+int probeCandidates (SuDoku*, board_constraint*);
+int constraintPropagation (SuDoku*, board_constraint*, c_address, handler_func, search_state*);
+int searchOption (int, char*);
+
+
+void resetSearch (search_state *search, long node_limit, long time_limit) {
+  search->node_limit = node_limit;
+  search->time_limit = time_limit;
+  gettimeofday(&search->start, NULL);
+  search->nodes = 0;
+  search->dead_ends = 0;
+  search->backjumps = 0;
+  search->aborted = 0;
+}
+
+void configureSearch (search_state *search, int branch, int values, int random_ties, unsigned int seed) {
+  search->branch = branch;
+  search->values = values;
+  search->random_ties = random_ties;
+  search->seed = seed;
+}
+
+unsigned int searchHash (unsigned int seed, int a, int b) {
+/*
+ * Mix the seed with two small numbers into a well scattered key.
+ *
+ */
+
+  unsigned int h = seed * 0x9E3779B1u + a * 0x85EBCA77u + b * 0xC2B2AE3Du;
+
+  h ^= h >> 16;
+  h *= 0x7FEB352Du;
+  h ^= h >> 15;
+  h *= 0x846CA68Bu;
+  h ^= h >> 16;
+  return(h);
+}
+
+unsigned int valueKey (search_state *search, int index, int value) {
+/*
+ * Candidates are tried in increasing order of this key.  The value is kept
+ * in the low bits so no two candidates of one cell share a key.
+ *
+ */
+
+  if (search->values == VALUES_DESCENDING) {
+    return(10 - value);
+  }
+  if (search->values == VALUES_RANDOM) {
+    return((searchHash(search->seed, index, value) << 4) | value);
+  }
+  return(value);
+}
+
+long searchElapsed (search_state *search) {
+/*
+ * Milliseconds since the search was started.
+ *
+ */
+
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+  return((now.tv_sec - search->start.tv_sec) * 1000 + (now.tv_usec - search->start.tv_usec) / 1000);
+}
+
+int searchExpired (search_state *search) {
+  long nodes;
+
+  if (search->aborted != 0) { return(1); }
+
+  nodes = __sync_add_and_fetch(&search->nodes, 1);
+  if (search->node_limit != 0 && nodes > search->node_limit) {
+    search->aborted = 1;
+  } else if (search->time_limit != 0 && searchElapsed(search) >= search->time_limit) {
+    search->aborted = 1;
+  }
+
+  return(search->aborted);
+}
+
+int probeCandidates (SuDoku *board, board_constraint *constraint) {
+  SuDoku probeBoard, common;
+  board_constraint probeConstraint;
+  int i,j,k,l,m;
+  int sum, size, surviving, probes = 0, changed;
 
+  for (size=2; size<=PROBE_CANDIDATES; size++) {
+    for (i=1; i<=9; i++) {
+      for (j=1; j<=9; j++) {
+        if (board->section[i].cell[j] != 0) { continue; }
 
-void constraintPropagation (SuDoku *board, board_constraint *constraint, c_address curCell, handler_func solution) {
+        sum = 0;
+        for (k=1; k<=9; k++) {
+          sum += constraint->section[i].cell[j].value[k];
+        }
+        if (sum != size) { continue; }
+
+        surviving = 0;
+        for (k=1; k<=9; k++) {
+          if (constraint->section[i].cell[j].value[k] == 0) { continue; }
+          if (probes == probe_limit) { return(1); }
+          probes++;
+
+          memcpy(&probeBoard, board, sizeof(SuDoku));
+          memcpy(&probeConstraint, constraint, sizeof(board_constraint));
+          placeValue(&probeBoard, i, j, k);
+          if (scanBoard(&probeBoard, &probeConstraint) == 0 && checkRules(&probeBoard) == 0) {
+            memcpy(board, &probeBoard, sizeof(SuDoku));
+            return(0);
+          }
+          updateConstraint(&probeBoard, &probeConstraint);
+          if (checkConstraintRules(&probeBoard, &probeConstraint) == 1) {
+            dropCandidate(constraint, i, j, k, constraintConflict(&probeBoard, &probeConstraint));
+            continue;
+          }
+
+         /* Keep only the cells every surviving candidate agrees on */
+          if (surviving == 0) {
+            memcpy(&common, &probeBoard, sizeof(SuDoku));
+          } else {
+            for (l=1; l<=9; l++) {
+              for (m=1; m<=9; m++) {
+                if (common.section[l].cell[m] != probeBoard.section[l].cell[m]) {
+                  common.section[l].cell[m] = 0;
+                }
+              }
+            }
+          }
+          surviving++;
+        }
+
+        if (surviving == 0) {
+          return(2);
+        }
+
+        changed = 0;
+        for (l=1; l<=9; l++) {
+          for (m=1; m<=9; m++) {
+            if (board->section[l].cell[m] == 0 && common.section[l].cell[m] != 0) {
+              constraint->placed_why[l][m] = levelsUpTo(constraint->depth);
+              placeValue(board, l, m, common.section[l].cell[m]);
+              changed = 1;
+            }
+          }
+        }
+
+        if (changed != 0) {
+          if (scanBoard(board, constraint) == 0) {
+            return(checkRules(board) == 0 ? 0 : 2);
+          }
+          updateConstraint(board, constraint);
+          if (checkConstraintRules(board, constraint) == 1) {
+            return(2);
+          }
+        }
+      }
+    }
+  }
+
+  return(1);
+}
+
+int deadEnd (search_state *search, unsigned long long placed_hash, unsigned long long scanned_hash) {
+/*
+ * Count a dead end and remember the board, both as the guess left it and
+ * after scanBoard, in the transposition table.
+ *
+ */
+
+  __sync_add_and_fetch(&search->dead_ends, 1);
+  recordDead(placed_hash);
+  recordDead(scanned_hash);
+  return(SEARCH_CONTINUE);
+}
+
+int searchBranch (SuDoku *board, board_constraint *constraint, c_address curCell, handler_func solution, search_state *search) {
+/*
+ * Place the guess of curCell, propagate, and search the board it leaves.
+ *
+ */
+
+  c_address nextMove;
+  unsigned long long placed_hash, scanned_hash;
+  unsigned int lost;
+  int result, level;
+
+  level = ++constraint->depth;
+  constraint->placed_why[curCell.section][curCell.cell] = levelBit(level);
+  constraint->conflict = levelsUpTo(level);	/* until a dead end says otherwise, every guess so far is to blame */
+
+  placeValue(board, curCell.section, curCell.cell, curCell.value);
+  placed_hash = board->hash;
+  if (deadState(placed_hash) != 0) {
+    TRACE_EVENT(TRACE_CONTRADICTION, 0, 0, 0, TRACE_STAGE_DEAD);
+    __sync_add_and_fetch(&search->dead_ends, 1);
+    return(SEARCH_CONTINUE);
+  }
+
+  if (scanBoard(board, constraint) == 0) {
+    if (checkRules(board) != 0) {	/* filled around broken clues */
+      TRACE_EVENT(TRACE_CONTRADICTION, 0, 0, 0, TRACE_STAGE_RULES);
+      return(deadEnd(search, placed_hash, board->hash));
+    }
+    TRACE_EVENT(TRACE_SOLUTION, 0, 0, 0, 0);
+    solution(board);
+    return(SEARCH_SOLVED);
+  }
+  TRACE_EVENT(TRACE_PROPAGATE, 0, 0, 0, traceFilled(board));
+  scanned_hash = board->hash;
+  if (scanned_hash != placed_hash && deadState(scanned_hash) != 0) {
+    TRACE_EVENT(TRACE_CONTRADICTION, 0, 0, 0, TRACE_STAGE_DEAD);
+    return(deadEnd(search, placed_hash, scanned_hash));
+  }
+
+  updateConstraint(board, constraint);
+  if (checkConstraintRules(board, constraint) == 1) {
+    TRACE_EVENT(TRACE_CONTRADICTION, 0, 0, 0, TRACE_STAGE_RULES);
+    constraint->conflict = constraintConflict(board, constraint);
+    return(deadEnd(search, placed_hash, scanned_hash));
+  }
+  if (use_templates != 0 && unit_boxes != 0) {	/* templates assume the sections are units */
+    result = templatePropagate(board, constraint);
+    if (result == 0) {
+      TRACE_EVENT(TRACE_SOLUTION, 0, 0, 0, 0);
+      solution(board);
+      return(SEARCH_SOLVED);
+    }
+    if (result == 2) {
+      TRACE_EVENT(TRACE_CONTRADICTION, 0, 0, 0, TRACE_STAGE_TEMPLATES);
+      return(deadEnd(search, placed_hash, scanned_hash));
+    }
+  }
+  if (probe_limit != 0) {
+    result = probeCandidates(board, constraint);
+    if (result == 0) {
+      TRACE_EVENT(TRACE_SOLUTION, 0, 0, 0, 0);
+      solution(board);
+      return(SEARCH_SOLVED);
+    }
+    if (result == 2) {
+      TRACE_EVENT(TRACE_CONTRADICTION, 0, 0, 0, TRACE_STAGE_PROBES);
+      return(deadEnd(search, placed_hash, scanned_hash));
+    }
+  }
+  nextMove = chooseMove(board, constraint, search);
+
+  if (nextMove.section != 0 && nextMove.value != 0) {
+    lost = cellWhy(constraint, nextMove.section, nextMove.cell);
+    result = constraintPropagation(board, constraint, nextMove, solution, search);
+
+   /* Every candidate of the next cell was tried, so this board is dead, for the reasons its values died and the rest were lost */
+    if (result == SEARCH_CONTINUE) {
+      recordDead(placed_hash);
+      recordDead(scanned_hash);
+      if (level < CONFLICT_LEVELS) { constraint->conflict &= ~levelBit(level + 1); }
+      constraint->conflict |= lost;
+    }
+    return(result);
+  }
+
+  return(deadEnd(search, placed_hash, scanned_hash));
+}
+
+int constraintPropagation (SuDoku *board, board_constraint *constraint, c_address curCell, handler_func solution, search_state *search) {
   SuDoku *newBoard;
   board_constraint *newConstraint;
   c_address nextMove;
+  unsigned int conflict = 0;
+  int result, level;
+
+  if (searchExpired(search) != 0) {
+    return(SEARCH_ABORTED);
+  }
+  level = constraint->depth + 1;
 
-  nextMove = nextConstraint(constraint, curCell);
+  nextMove = nextValue(constraint, curCell, search);
   if (nextMove.section == curCell.section && nextMove.cell == curCell.cell) {
     newBoard = malloc(sizeof(SuDoku));
     memcpy(newBoard, board, sizeof(SuDoku));
@@ -25,55 +385,91 @@ void constraintPropagation (SuDoku *board, board_constraint *constraint, c_addre
     newConstraint = malloc(sizeof(board_constraint));
     memcpy(newConstraint, constraint, sizeof(board_constraint));
 
-    constraintPropagation(newBoard, newConstraint, nextMove, solution);
+    result = constraintPropagation(newBoard, newConstraint, nextMove, solution, search);
+    conflict = newConstraint->conflict;
     free(newBoard);
     free(newConstraint);
-  }
 
-  board->section[curCell.section].cell[curCell.cell] = curCell.value;
-  if (scanBoard(board, constraint) == 0) {
-    solution(board);
-    exit(0);
-  }
-  updateConstraint(board, constraint);
-  if (checkConstraintRules(board, constraint) == 1) {
-    return;
-  }
-  nextMove = findLeastConstrained(board, constraint);
+    if (result != SEARCH_CONTINUE) {
+      return(result);
+    }
 
-  if (nextMove.section != 0 && nextMove.value != 0) {
-    constraintPropagation(board, constraint, nextMove, solution);
+   /* The other values died without this guess to blame, so this one would too */
+    if ((conflict & levelBit(level)) == 0) {
+      __sync_add_and_fetch(&search->backjumps, 1);
+      constraint->conflict = conflict;
+      return(SEARCH_CONTINUE);
+    }
   }
 
-  return;
+  TRACE_EVENT(TRACE_BRANCH, curCell.section, curCell.cell, curCell.value, 0);
+  result = searchBranch(board, constraint, curCell, solution, search);
+  TRACE_EVENT(TRACE_END, curCell.section, curCell.cell, curCell.value, result);
+
+ /* The cell is dead for the reasons of all its values, or of any one that did not need the guess */
+  if (result == SEARCH_CONTINUE && (constraint->conflict & levelBit(level)) != 0) {
+    constraint->conflict |= conflict;
+  }
+  return(result);
 }
 
-c_address findLeastConstrained (SuDoku *board, board_constraint *constraint) {
+c_address chooseMove (SuDoku *board, board_constraint *constraint, search_state *search) {
   int i,j,k;
-  int sum, first_value, least_sum=9;
+  int sum, best_sum, better;
+  unsigned int key, best_key=0;
   c_address bestMove;
 
+  if (search->values == VALUES_ASCENDING && search->random_ties == 0) {
+    if (search->branch == BRANCH_MOST) {
+      return(findMostConstrained(board, constraint));
+    }
+    return(findLeastConstrained(board, constraint));
+  }
+
   bestMove.section = 0;
   bestMove.cell = 0;
   bestMove.value = 0;
+  best_sum = (search->branch == BRANCH_MOST) ? 0 : 10;
 
   for (i=1; i<=9; i++) {
     for (j=1; j<=9; j++) {
+      if (board->section[i].cell[j] != 0) { continue; }
+
       sum = 0;
-      first_value = 0;
-      if (board->section[i].cell[j] == 0) {
-        for (k=1; k<=9; k++) {
-          if (constraint->section[i].cell[j].value[k] == 1) {
-            if (first_value == 0) { first_value = k; }
-            sum++;
-          }
-        }
-        if (sum < least_sum) {
-          bestMove.section = i;
-          bestMove.cell = j;
-          bestMove.value = first_value;
+      for (k=1; k<=9; k++) {
+        sum += constraint->section[i].cell[j].value[k];
+      }
+
+      if (search->branch == BRANCH_MOST) {
+        better = (sum > best_sum);
+      } else {
+        better = (sum < best_sum);
+      }
+
+      key = 0;
+      if (search->random_ties != 0) {
+        key = searchHash(search->seed, i, j);
+        if (sum == best_sum && key < best_key) { better = 1; }
+      }
+
+      if (better) {
+        bestMove.section = i;
+        bestMove.cell = j;
+        best_sum = sum;
+        best_key = key;
+      }
+    }
+  }
 
-          least_sum = sum;
+ /* Start the cell on the candidate with the lowest key */
+  if (bestMove.section != 0) {
+    best_key = ~0u;
+    for (k=1; k<=9; k++) {
+      if (constraint->section[bestMove.section].cell[bestMove.cell].value[k] == 1) {
+        key = valueKey(search, bestMove.cell + bestMove.section * 10, k);
+        if (key < best_key) {
+          bestMove.value = k;
+          best_key = key;
         }
       }
     }
@@ -82,6 +478,56 @@ c_address findLeastConstrained (SuDoku *board, board_constraint *constraint) {
   return(bestMove);
 }
 
+c_address nextValue (board_constraint *constraint, c_address curCell, search_state *search) {
+  int k;
+  unsigned int key, cur_key, best_key = ~0u;
+  c_address theMove;
+
+  if (search->values == VALUES_ASCENDING) {
+    return(nextConstraint(constraint, curCell));
+  }
+
+  theMove.section = 0;
+  theMove.cell = 0;
+  theMove.value = 0;
+  if (curCell.section == 0) {
+    return(theMove);
+  }
+
+  cur_key = valueKey(search, curCell.cell + curCell.section * 10, curCell.value);
+  for (k=1; k<=9; k++) {
+    if (constraint->section[curCell.section].cell[curCell.cell].value[k] == 1) {
+      key = valueKey(search, curCell.cell + curCell.section * 10, k);
+      if (key > cur_key && key < best_key) {
+        theMove.section = curCell.section;
+        theMove.cell = curCell.cell;
+        theMove.value = k;
+        best_key = key;
+      }
+    }
+  }
+
+  return(theMove);
+}
+
+c_address findLeastConstrained (SuDoku *board, board_constraint *constraint) {
+  int k,count;
+  c_address bestMove;
+
+  bestMove.value = 0;
+  for (count=0; count<=9; count++) {
+    if (bucketCell(board, constraint, count, &bestMove) != 0) {
+      for (k=1; k<=9 && constraint->section[bestMove.section].cell[bestMove.cell].value[k] == 0; k++);
+      if (k <= 9) { bestMove.value = k; }
+      return(bestMove);
+    }
+  }
+
+  bestMove.section = 0;
+  bestMove.cell = 0;
+  return(bestMove);
+}
+
 c_address nextConstraint (board_constraint *constraint, c_address curCell) {
   int i,j,k;
   c_address theMove;
@@ -117,36 +563,37 @@ c_address nextConstraint (board_constraint *constraint, c_address curCell) {
 }
 
 c_address findMostConstrained (SuDoku *board, board_constraint *constraint) {
-  int i,j,k;
-  int sum, first_value, least_sum=0;
+  int k,count;
   c_address bestMove;
 
-  bestMove.section = 0;
-  bestMove.cell = 0;
   bestMove.value = 0;
-
-  for (i=1; i<=9; i++) {
-    for (j=1; j<=9; j++) {
-      sum = 0;
-      first_value = 0;
-      if (board->section[i].cell[j] == 0) {
-        for (k=1; k<=9; k++) {
-          if (constraint->section[i].cell[j].value[k] == 1) {
-            if (first_value == 0) { first_value = k; }
-            sum++;
-          }
-        }
-        if (sum > least_sum) {
-          bestMove.section = i;
-          bestMove.cell = j;
-          bestMove.value = first_value;
-
-          least_sum = sum;
-        }
-      }
+  for (count=9; count>=1; count--) {
+    if (bucketCell(board, constraint, count, &bestMove) != 0) {
+      for (k=1; constraint->section[bestMove.section].cell[bestMove.cell].value[k] == 0; k++);
+      bestMove.value = k;
+      return(bestMove);
     }
   }
 
+  bestMove.section = 0;
+  bestMove.cell = 0;
   return(bestMove);
 }
 
+int searchOption (int opt, char *arg) {
+  switch(opt) {
+    case 'm':
+      use_templates = 1;
+      loadTemplates();	/* once, before -b forks and -t starts threads */
+      return(0);
+
+    case 'L':
+      probe_limit = atoi(arg);
+      return(0);
+
+    case 'H':
+      createDeadTable(atoi(arg));
+      return(0);
+  }
+  return(1);
+}
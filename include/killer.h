@@ -0,0 +1,232 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Killer cages.  A cage is a group of cells whose values must all differ
+ * and add up to the cage's sum.  Cages follow the board in its file, one
+ * per line, with the cells given by row and column:
+ *
+ *   cage 15 r1c1 r1c2 r2c1
+ *
+ * For every cage size and sum the sets of digits that fit are generated
+ * once, as nine bit masks (bit k-1 for value k).  A cage's open cells may
+ * only hold digits of a set that contains every digit already placed in
+ * the cage and whose other digits are still candidates of its open cells.
+ *
+ * addCage
+ * -------
+ * Parse one cage line and add it to the board's cages.  Exits on a
+ * malformed line or a cell already in a cage.
+ *
+ * cageConstraint
+ * --------------
+ * Remove the candidates of each cage's open cells that no digit set
+ * allows, and place a digit every set needs when only one cell of the
+ * cage can take it.  A broken cage has every candidate of its open cells
+ * removed.  Called by updateConstraint.
+ *
+ * checkCages
+ * ----------
+ * Returns 1 if a cage holds a value twice, goes over its sum, or is full
+ * without adding up to it, 0 otherwise.  Called by checkRules and
+ * checkConstraintRules.
+ *
+ */
+
+#define CAGE_MAX	81
+
+typedef struct killer_cage {
+	int size;
+	int sum;
+	c_address cells[9];
+} killer_cage;
+
+killer_cage killer_cages[CAGE_MAX];
+int killer_cage_count = 0;
+
+/* The cage of each section and cell, -1 for none */
+int cage_of[10][10];
+int cage_of_loaded = 0;
+
+/* Digit sets of each size and sum, cage_sets[ cage_set_first[size][sum] ] on */
+unsigned short cage_sets[512];
+int cage_set_first[10][46];
+int cage_set_count[10][46];
+int cage_sets_loaded = 0;
+
+void loadCageSets (void) {
+  int size, sum, mask, digit, total, index = 0;
+
+  if (cage_sets_loaded != 0) { return; }
+
+  for (size=1; size<=9; size++) {
+    for (sum=0; sum<=45; sum++) {
+      cage_set_first[size][sum] = index;
+      cage_set_count[size][sum] = 0;
+      for (mask=1; mask<512; mask++) {
+        if (__builtin_popcount(mask) != size) { continue; }
+
+        total = 0;
+        for (digit=1; digit<=9; digit++) {
+          if (mask & (1 << (digit-1))) { total += digit; }
+        }
+        if (total == sum) {
+          cage_sets[index++] = mask;
+          cage_set_count[size][sum]++;
+        }
+      }
+    }
+  }
+
+  cage_sets_loaded = 1;
+}
+
+int addCage (char *line, char *fname) {
+  killer_cage *cage;
+  char *token;
+  int i, j, section, cell;
+
+  loadCageSets();
+  if (cage_of_loaded == 0) {
+    for (i=1; i<=9; i++) {
+      for (j=1; j<=9; j++) {
+        cage_of[i][j] = -1;
+      }
+    }
+    cage_of_loaded = 1;
+  }
+
+  if (killer_cage_count == CAGE_MAX) {
+    printf("Error: too many cages in '%s'\n", fname);
+    exit(1);
+  }
+  cage = &killer_cages[killer_cage_count];
+  cage->size = 0;
+
+  token = strtok(line, " \t\r\n");		/* "cage" */
+  token = strtok(NULL, " \t\r\n");
+  if (token == NULL || sscanf(token, "%d", &cage->sum) != 1) {
+    printf("Error: cage without a sum in '%s'\n", fname);
+    exit(1);
+  }
+
+  while ((token = strtok(NULL, " \t\r\n")) != NULL) {
+    if (cage->size == 9 || parseCell(token, &cage->cells[cage->size]) != 0) {
+      printf("Error: bad cage cell '%s' in '%s'\n", token, fname);
+      exit(1);
+    }
+    section = cage->cells[cage->size].section;
+    cell = cage->cells[cage->size].cell;
+    if (cage_of[section][cell] != -1) {
+      printf("Error: cell %s is in more than one cage in '%s'\n", token, fname);
+      exit(1);
+    }
+    cage->size++;
+    cage_of[section][cell] = killer_cage_count;
+  }
+
+  if (cage->size == 0 || cage->sum < 1 || cage->sum > 45 || cage_set_count[cage->size][cage->sum] == 0) {
+    printf("Error: no digits make a cage of %d cells adding up to %d in '%s'\n", cage->size, cage->sum, fname);
+    exit(1);
+  }
+
+  killer_cage_count++;
+  return(0);
+}
+
+void cageConstraint (SuDoku *board, board_constraint *constraint) {
+  killer_cage *cage;
+  cell_constraint *c;
+  unsigned short set;
+  unsigned int why;
+  int i, j, k, value, placed, candidates, allowed, required, count, last, broken;
+
+  for (i=0; i<killer_cage_count; i++) {
+    cage = &killer_cages[i];
+
+    placed = 0;
+    candidates = 0;
+    broken = 0;
+    why = 0;
+    for (j=0; j<cage->size; j++) {
+      why |= cellWhy(constraint, cage->cells[j].section, cage->cells[j].cell);
+      value = board->section[ cage->cells[j].section ].cell[ cage->cells[j].cell ];
+      if (value != 0) {
+        if (placed & (1 << (value-1))) { broken = 1; }
+        placed |= 1 << (value-1);
+      } else {
+        c = &constraint->section[ cage->cells[j].section ].cell[ cage->cells[j].cell ];
+        for (k=1; k<=9; k++) {
+          if (c->value[k] == 1) { candidates |= 1 << (k-1); }
+        }
+      }
+    }
+
+   /* Digit sets holding everything placed, with the rest still possible */
+    allowed = 0;
+    required = 0x1FF;
+    for (j=0; j<cage_set_count[cage->size][cage->sum] && broken == 0; j++) {
+      set = cage_sets[ cage_set_first[cage->size][cage->sum] + j ];
+      if ((set & placed) != placed || (set & ~placed & ~candidates) != 0) { continue; }
+      allowed |= set & ~placed;
+      required &= set & ~placed;
+    }
+    if (allowed == 0) { required = 0; }
+
+    for (j=0; j<cage->size; j++) {
+      if (board->section[ cage->cells[j].section ].cell[ cage->cells[j].cell ] != 0) { continue; }
+      c = &constraint->section[ cage->cells[j].section ].cell[ cage->cells[j].cell ];
+      for (k=1; k<=9; k++) {
+        if ((allowed & (1 << (k-1))) == 0) { dropCandidate(constraint, cage->cells[j].section, cage->cells[j].cell, k, why); }
+      }
+    }
+
+   /* A digit every set needs, with one cell of the cage left for it */
+    for (k=1; k<=9; k++) {
+      if ((required & (1 << (k-1))) == 0) { continue; }
+
+      count = 0;
+      last = 0;
+      for (j=0; j<cage->size; j++) {
+        if (board->section[ cage->cells[j].section ].cell[ cage->cells[j].cell ] != 0) { continue; }
+        if (constraint->section[ cage->cells[j].section ].cell[ cage->cells[j].cell ].value[k] == 1) {
+          count++;
+          last = j;
+        }
+      }
+      if (count == 1) {
+        for (value=1; value<=9; value++) {
+          if (value != k) { dropCandidate(constraint, cage->cells[last].section, cage->cells[last].cell, value, why); }
+        }
+      }
+    }
+  }
+}
+
+int checkCages (SuDoku *board) {
+  killer_cage *cage;
+  int i, j, value, placed, sum, open;
+
+  for (i=0; i<killer_cage_count; i++) {
+    cage = &killer_cages[i];
+
+    placed = 0;
+    sum = 0;
+    open = 0;
+    for (j=0; j<cage->size; j++) {
+      value = board->section[ cage->cells[j].section ].cell[ cage->cells[j].cell ];
+      if (value == 0) {
+        open++;
+        continue;
+      }
+      if (placed & (1 << (value-1))) { return(1); }
+      placed |= 1 << (value-1);
+      sum += value;
+    }
+
+    if (sum > cage->sum || (open == 0 && sum != cage->sum)) {
+      return(1);
+    }
+  }
+
+  return(0);
+}
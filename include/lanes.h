@@ -0,0 +1,182 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Lockstep propagation of several puzzles at once.
+ *
+ * The candidates of up to LANES boards are kept as one nine bit mask per
+ * cell, interleaved so that cell i of every board sits in one vector,
+ * lane_cells[i], one lane per board.  Every step of the propagation is
+ * the same for all boards, so each vector operation works on all of them
+ * together: naked singles are removed from their peers, hidden singles
+ * are found per unit of the unit table, and a board is broken when a
+ * cell has no candidate or a unit is missing a number.
+ *
+ * Most puzzles are finished by this alone.  The rest are handed back so
+ * the caller can give them to the usual search.
+ *
+ * loadLanes
+ * ---------
+ * Copy up to LANES boards into the lanes.  Unused lanes are left empty,
+ * which reads as broken.
+ *
+ * propagateLanes
+ * --------------
+ * Run the propagation on every lane until none of them changes.  status
+ * gets one of the LANE_ codes for each board, and each board that is not
+ * broken gets every cell that was narrowed to a single number.
+ *
+ */
+
+#define LANES 16
+
+#define LANE_SOLVED	0
+#define LANE_BROKEN	1
+#define LANE_OPEN	2
+
+/* One nine bit candidate mask per board */
+typedef unsigned short lane_vec __attribute__ ((vector_size (LANES * sizeof(unsigned short))));
+
+lane_vec lane_cells[81];
+
+/* Row major cell indexes of the units and peers, from the unit table */
+int lane_units[MAX_UNITS][9];
+int lane_peers[81][MAX_PEERS];
+int lane_peer_count[81];
+int lane_tables_loaded = 0;
+
+void loadLaneTables (void);
+void loadLanes (SuDoku*, int);
+void propagateLanes (SuDoku*, int, int*);
+
+void loadLaneTables (void) {
+  int i, j, k, index;
+
+  if (lane_tables_loaded != 0) { return; }
+  if (unit_count == 0) { loadUnits(); }
+
+  for (i=0; i<unit_count; i++) {
+    for (j=0; j<9; j++) {
+      lane_units[i][j] = cellIndex(units[i][j].section, units[i][j].cell);
+    }
+  }
+
+  for (i=1; i<=9; i++) {
+    for (j=1; j<=9; j++) {
+      index = cellIndex(i, j);
+      lane_peer_count[index] = cell_peer_count[i][j];
+      for (k=0; k<cell_peer_count[i][j]; k++) {
+        lane_peers[index][k] = cellIndex(cell_peers[i][j][k].section, cell_peers[i][j][k].cell);
+      }
+    }
+  }
+
+  lane_tables_loaded = 1;
+}
+
+void loadLanes (SuDoku *boards, int count) {
+  int i, j, lane, value;
+
+  loadLaneTables();
+
+  for (i=0; i<81; i++) {
+    for (lane=0; lane<LANES; lane++) {
+      lane_cells[i][lane] = 0;
+    }
+  }
+
+  for (lane=0; lane<count; lane++) {
+    for (i=1; i<=9; i++) {
+      for (j=1; j<=9; j++) {
+        value = boards[lane].section[i].cell[j];
+        lane_cells[ cellIndex(i, j) ][lane] = (value == 0) ? 0x1FF : 1 << (value - 1);
+      }
+    }
+  }
+}
+
+void propagateLanes (SuDoku *boards, int count, int *status) {
+  lane_vec single, once, twice, hidden, hidden_lanes, before, changed, broken, open, zero = { 0 }, full;
+  lane_vec *c;
+  int i, j, k, lane, value, mask;
+
+  for (lane=0; lane<LANES; lane++) {
+    full[lane] = 0x1FF;
+  }
+
+  do {
+    changed = zero;
+
+   /* Naked singles: a cell down to one number takes it from its peers */
+    for (i=0; i<81; i++) {
+      c = &lane_cells[i];
+      single = *c & (lane_vec)((*c & (*c - 1)) == 0);
+      for (j=0; j<lane_peer_count[i]; j++) {
+        before = lane_cells[ lane_peers[i][j] ];
+        lane_cells[ lane_peers[i][j] ] = before & ~single;
+        changed |= before ^ lane_cells[ lane_peers[i][j] ];
+      }
+    }
+
+   /* Hidden singles: a number with one place left in a unit goes there */
+    for (i=0; i<unit_count; i++) {
+      once = zero;
+      twice = zero;
+      for (j=0; j<9; j++) {
+        c = &lane_cells[ lane_units[i][j] ];
+        twice |= once & *c;
+        once |= *c;
+      }
+      once &= ~twice;
+
+      for (j=0; j<9; j++) {
+        c = &lane_cells[ lane_units[i][j] ];
+        hidden = *c & once;
+        before = *c;
+        hidden_lanes = (lane_vec)(hidden != 0);
+        *c = (hidden & hidden_lanes) | (*c & ~hidden_lanes);
+        changed |= before ^ *c;
+      }
+    }
+
+    for (lane=0; lane<LANES; lane++) {
+      if (changed[lane] != 0) { break; }
+    }
+  } while (lane < LANES);
+
+ /* A cell without a candidate, or a unit without some number, is broken */
+  broken = zero;
+  open = zero;
+  for (i=0; i<81; i++) {
+    broken |= (lane_vec)(lane_cells[i] == 0);
+    open |= (lane_vec)((lane_cells[i] & (lane_cells[i] - 1)) != 0);
+  }
+  for (i=0; i<unit_count; i++) {
+    once = zero;
+    for (j=0; j<9; j++) {
+      once |= lane_cells[ lane_units[i][j] ];
+    }
+    broken |= (lane_vec)(once != full);
+  }
+
+  for (lane=0; lane<count; lane++) {
+    if (broken[lane] != 0) {
+      status[lane] = LANE_BROKEN;
+      continue;
+    }
+    status[lane] = (open[lane] != 0) ? LANE_OPEN : LANE_SOLVED;
+
+    for (i=1; i<=9; i++) {
+      for (j=1; j<=9; j++) {
+        mask = lane_cells[ cellIndex(i, j) ][lane];
+        value = 0;
+        if (mask != 0 && (mask & (mask - 1)) == 0) {
+          for (k=mask; k>1; k>>=1) { value++; }
+          value++;
+        }
+        if (boards[lane].section[i].cell[j] != value) {
+          placeValue(&boards[lane], i, j, value);
+        }
+      }
+    }
+  }
+}
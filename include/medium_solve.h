@@ -3,235 +3,234 @@
  *
  * Functions for medium difficulty solving methods of the SuDoku puzzles.
  *
- * guessOneCell
- * ------------
- * For one section, guess every possible value, then fill in the cross section
- * cells and see if a solution can be found.  If any number has only one cell
- * that yields a solution, return that address and value.
+ * A template is one complete, legal placement of a single number on the
+ * board: one cell in every row, column and section.  There are 46,656 of
+ * them, kept as 81 bit masks in row major order (see cellIndex).
  *
- * fillBoard
- * ---------
- * Fill the entire board with a specified number.  If a solution is found, it then
- * tallys the location of each number by cell.  The goal is for the calling program
- * to then determine if any number could only exist in one cell for all solutions.
+ * loadTemplates
+ * -------------
+ * Build the template table.  Templates are generated in order of the
+ * column used on each row, so every template sharing the first rows sits
+ * in one aligned block of the table.  It has to be called before the
+ * first templateReduce, which exits without it, and before any fork or
+ * thread that uses it.
+ *
+ * templateReduce
+ * --------------
+ * For each number, keep only the templates that fit the board and the
+ * constraints.  A cell no surviving template covers loses the number as
+ * a candidate, a cell every surviving template covers gets the number
+ * placed.  Returns 0 if nothing changed, 1 if the board or constraints
+ * changed and 2 if some number has no template left.
+ *
+ * templatePropagate
+ * -----------------
+ * Run templateReduce and scanBoard until neither makes progress.  Returns
+ * 0 if the board is solved, 1 if it is still open and 2 if a rule is broken.
  *
  */
 
-int cross_sections[5];
+#define TEMPLATE_COUNT 46656
 
-c_address guessOneCell (SuDoku*, int, int*);
-c_address nextCrossSectionCell (SuDoku*, int, int, int);
+/* 81 bit mask of board cells, row major, bits 0-63 in lo and 64-80 in hi */
+typedef struct board_mask {
+	unsigned long long lo;
+	unsigned long long hi;
+} board_mask;
 
-void fillBoard (SuDoku*, c_address, int, SuDoku*, int*);
-void fillSection (SuDoku*, c_address, int, int, int*);
-void adjustIndex (int, int*);
+board_mask templates[TEMPLATE_COUNT];
+int templates_loaded = 0;
 
-c_address guessOneCell (SuDoku *board, int section, int *solutions) {
-  SuDoku *newBoard;
-  c_address nextmove, theMove;
-  int values_available[9], values_count=0;
-  int i,j, start_index, num_solutions;
-  int cells_array[3];
+/* Templates sharing the columns of rows 0 through n, the block size at depth n */
+int template_block[9] = { 5184, 864, 288, 48, 12, 6, 2, 1, 1 };
 
-  if (section%3 == section || section == 3) {
-    cross_sections[0] = 1;
-    cross_sections[1] = 2;
-    cross_sections[2] = 3;
-    cross_sections[3] = section+3;
-    cross_sections[4] = section+6;
+/* Use templateReduce as a propagation stage before every guess */
+int use_templates = 0;
 
-  } else if (section%6 == section || section == 6 ) {
-    cross_sections[0] = section-3;
-    cross_sections[1] = 4;
-    cross_sections[2] = 5;
-    cross_sections[3] = 6;
-    cross_sections[4] = section+3;
+void loadTemplates (void);
+int templateReduce (SuDoku*, board_constraint*);
+int templatePropagate (SuDoku*, board_constraint*);
 
+void maskSet (board_mask *mask, int index) {
+  if (index < 64) {
+    mask->lo |= 1ULL << index;
   } else {
-    cross_sections[0] = section-6;
-    cross_sections[1] = section-3;
-    cross_sections[2] = 7;
-    cross_sections[3] = 8;
-    cross_sections[4] = 9;
+    mask->hi |= 1ULL << (index - 64);
   }
+}
 
-  for (i=1; i<=9; i++) {
-    if (valueAvailable(board, section, i) == 0) {
-      values_available[values_count] = i;
-      values_count++;
+int maskTest (board_mask *mask, int index) {
+  if (index < 64) {
+    return((mask->lo >> index) & 1);
+  }
+  return((mask->hi >> (index - 64)) & 1);
+}
+
+void addTemplate (int *columns, int row, int *count) {
+/*
+ * Recursively place the number on each row in a column and section not
+ * yet used.  Columns are tried in increasing order.
+ *
+ */
+
+  int col, i;
+  board_mask *mask;
+
+  if (row == 9) {
+    mask = &templates[*count];
+    mask->lo = 0;
+    mask->hi = 0;
+    for (i=0; i<9; i++) {
+      maskSet(mask, i*9 + columns[i]);
     }
+    (*count)++;
+    return;
   }
 
-  newBoard = malloc(sizeof(SuDoku));
-  for (i=0; i<values_count; i++) {
-    num_solutions=0;
-    for (j=1; j<=9; j++) {
-      if (board->section[section].cell[j] == 0) {
-        *solutions=0;
-
-        memcpy(newBoard, board, sizeof(SuDoku));
-        newBoard->section[section].cell[j] = values_available[i];
-        nextmove = nextCrossSectionCell(newBoard, cross_sections[0], 1, values_available[i]);
-        if (nextmove.section != 0) {
-          adjustIndex(nextmove.section, &start_index);
-          fillSection (newBoard, nextmove, values_available[i], start_index, solutions);
-
-          if (*solutions > 0) {
-            theMove.section = section;
-            theMove.cell = j;
-            theMove.value = values_available[i];
-
-            num_solutions++;
-          }
-        }
-      }
+  for (col=0; col<9; col++) {
+    for (i=0; i<row; i++) {
+      if (columns[i] == col) { break; }
+      if (i/3 == row/3 && columns[i]/3 == col/3) { break; }
     }
-    if (num_solutions == 1) {
-      return(theMove);
+    if (i == row) {
+      columns[row] = col;
+      addTemplate(columns, row+1, count);
     }
   }
+}
+
+void loadTemplates (void) {
+  int columns[9];
+  int count = 0;
 
-  theMove.section = 0;
-  theMove.cell = 0;
-  theMove.value = 0;
-  return(theMove);
+  if (templates_loaded != 0) { return; }
+
+  addTemplate(&columns[0], 0, &count);
+  if (count != TEMPLATE_COUNT) {
+    printf("Error: generated %d templates, expected %d\n", count, TEMPLATE_COUNT);
+    exit(1);
+  }
+  templates_loaded = 1;
 }
 
-void fillBoard (SuDoku *board, c_address curCell, int value, SuDoku *tally, int *solutions) {
-  SuDoku *newBoard;
-  c_address nextMove;
-  int nextcellopen;
-  int i,j;
-
-  if (valueAvailable(board, curCell.section, value) != 0) {
-    nextMove = nextCell(board, curCell.section+1, 1);
-    if (nextMove.section == 0) {
-      if (checkRules(board) == 0) {
-        for (i=1; i<=9; i++) {
-          for (j=1; j<=9; j++) {
-            if (board->section[i].cell[j] == value) {
-              (tally->section[i].cell[j])++;
-              j=10;
-            }
-          }
-        }
-        (*solutions)++;
-        return;
-      }
-    }
+int templateReduce (SuDoku *board, board_constraint *constraint) {
+  board_mask allowed, covered, always, *t;
+  unsigned long long bad_lo, bad_hi;
+  int placed_row[9], placed_col[9], placed_box[9];
+  int i, j, k, index, row, col, surviving, changed = 0;
 
-    fillBoard(board, nextMove, value, tally, solutions);
+  if (templates_loaded == 0) {	/* an empty table would strip every candidate */
+    printf("Error: templates used before loadTemplates\n");
+    exit(1);
+  }
 
-  } else {
-    nextcellopen = anotherCellOpen(board, curCell);
-    if (nextcellopen != 0) {
-      nextMove = curCell;
-      nextMove.cell = nextcellopen;
-
-      newBoard = malloc(sizeof(SuDoku));
-      memcpy(newBoard, board, sizeof(SuDoku));
-      fillBoard(newBoard, nextMove, value, tally, solutions);
-      free(newBoard);
-    }
+  for (k=1; k<=9; k++) {	/* each number */
 
-    board->section[curCell.section].cell[curCell.cell] = value;
-    if (checkRules(board) != 0) {
-      return;
+   /* Cells allowed to hold k: open candidates, or where k is already placed */
+    for (i=0; i<9; i++) {
+      placed_row[i] = -1;
+      placed_col[i] = -1;
+      placed_box[i] = -1;
     }
-    nextMove = nextCell(board, curCell.section+1, 1);
-    if ( nextMove.section == 0 ) {
-      if (checkRules(board) == 0) {
-        for (i=1; i<=9; i++) {
-          for (j=1; j<=9; j++) {
-            if (board->section[i].cell[j] == value) {
-              (tally->section[i].cell[j])++;
-              j=10;
-            }
+    for (i=1; i<=9; i++) {
+      for (j=1; j<=9; j++) {
+        if (board->section[i].cell[j] == k) {
+          index = cellIndex(i, j);
+          placed_row[index/9] = index;
+          placed_col[index%9] = index;
+          placed_box[i-1] = index;
+        }
+      }
+    }
+
+    allowed.lo = 0;
+    allowed.hi = 0;
+    for (i=1; i<=9; i++) {
+      for (j=1; j<=9; j++) {
+        index = cellIndex(i, j);
+        if (board->section[i].cell[j] == k) {
+          maskSet(&allowed, index);
+        } else if (board->section[i].cell[j] == 0 && constraint->section[i].cell[j].value[k] == 1) {
+          if (placed_row[index/9] == -1 && placed_col[index%9] == -1 && placed_box[i-1] == -1) {
+            maskSet(&allowed, index);
           }
         }
-        (*solutions)++;
       }
-      return;
     }
 
-    fillBoard(board, nextMove, value, tally, solutions);
-  }
+   /* Walk the table, skipping a whole block on the first row that does not fit */
+    covered.lo = 0;
+    covered.hi = 0;
+    always.lo = ~0ULL;
+    always.hi = ~0ULL;
+    surviving = 0;
+
+    i = 0;
+    while (i < TEMPLATE_COUNT) {
+      t = &templates[i];
+      bad_lo = t->lo & ~allowed.lo;
+      bad_hi = t->hi & ~allowed.hi;
+      if (bad_lo != 0 || bad_hi != 0) {
+        if (bad_lo != 0) {
+          row = __builtin_ctzll(bad_lo) / 9;
+        } else {
+          row = (64 + __builtin_ctzll(bad_hi)) / 9;
+        }
+        i = (i / template_block[row] + 1) * template_block[row];
+        continue;
+      }
 
-  return;
-}
+      covered.lo |= t->lo;
+      covered.hi |= t->hi;
+      always.lo &= t->lo;
+      always.hi &= t->hi;
+      surviving++;
+      i++;
+    }
+
+    if (surviving == 0) {
+      return(2);
+    }
 
-c_address nextCrossSectionCell (SuDoku *board, int section, int cell, int value) {
-  int i,j,k,l=cell;
-  c_address theCell;
+    for (i=1; i<=9; i++) {
+      for (j=1; j<=9; j++) {
+        if (board->section[i].cell[j] != 0) { continue; }
 
-  i=0;
-  while (cross_sections[i] != section) {
-    i++;
-  }
-  for (j=i; j<5; j++) {
-    if (valueAvailable(board, section, value) == 0) {
-      if (j != i ) {l = 0;}
-      for (k=l; k<=9; k++) {
-        if (board->section[cross_sections[j]].cell[k] == 0) {
-          theCell.section = cross_sections[j];
-          theCell.cell = k;
-          return(theCell);
+        index = cellIndex(i, j);
+        if (maskTest(&always, index)) {
+          placeValue(board, i, j, k);
+          for (col=1; col<=9; col++) {
+            dropCandidate(constraint, i, j, col, levelsUpTo(constraint->depth));
+          }
+          changed = 1;
+        } else if (constraint->section[i].cell[j].value[k] == 1 && maskTest(&covered, index) == 0) {
+          dropCandidate(constraint, i, j, k, levelsUpTo(constraint->depth));
+          changed = 1;
         }
       }
     }
   }
 
-  theCell.section = 0;
-  theCell.cell = 0;
-  return(theCell);
+  return(changed);
 }
 
-void fillSection (SuDoku *board, c_address curCell, int value, int index, int *solutions) {
-  SuDoku *newBoard;
-  c_address nextMove;
-  int nextcellopen;
+int templatePropagate (SuDoku *board, board_constraint *constraint) {
+  int result;
 
-  nextcellopen = anotherCellOpen(board, curCell);
-  if (nextcellopen != 0) {
-    nextMove = curCell;
-    nextMove.cell = nextcellopen;
-
-    newBoard = malloc(sizeof(SuDoku));
-    memcpy(newBoard, board, sizeof(SuDoku));
-    fillSection(newBoard, nextMove, value, index, solutions);
-    free(newBoard);
-  }
-
-  board->section[curCell.section].cell[curCell.cell] = value;
-  if (checkRules(board) != 0) {
-    return;
-  }
-
-  if ( index == 4 ) {
-    if (checkRules(board) == 0) {
-      (*solutions)++;
+  result = templateReduce(board, constraint);
+  while (result == 1) {
+    if (scanBoard(board, constraint) == 0) {
+      return(0);
     }
-    return;
-  }
-  nextMove = nextCrossSectionCell(board, cross_sections[index+1], 1, value);
-  if ( nextMove.section == 0 ) {
-    if (checkRules(board) == 0) {
-      (*solutions)++;
-      return;
+    updateConstraint(board, constraint);
+    if (checkConstraintRules(board, constraint) == 1 || checkRules(board) == 1) {
+      return(2);
     }
+    result = templateReduce(board, constraint);
   }
 
-  adjustIndex(nextMove.section, &index);
-  fillSection(board, nextMove, value, index, solutions);
-
-  return;
-}
-
-void adjustIndex (int section, int *index) {
-  int i;
-
-  for (i=0; i<5; i++) {
-    if (cross_sections[i] == section) { *index = i; return; }
+  if (result == 2) {
+    return(2);
   }
+  return(1);
 }
-
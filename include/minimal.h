@@ -0,0 +1,166 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Clue minimality.  A puzzle is minimal when it has one solution and
+ * removing any clue gives it more than one.
+ *
+ * Removing a clue never loses the known solution, so the question for
+ * each clue is only whether a second solution appears.  Any second
+ * solution must differ from the known one on the removed cell (otherwise
+ * it would already solve the full puzzle), so each clue is checked by a
+ * single search of the puzzle without the clue and with the clue's value
+ * struck from the cell's candidates.  The clue is redundant exactly when
+ * that search finds nothing.  The search never revisits the known
+ * solution, and most of these searches die in propagation.
+ *
+ * clueNeeded
+ * ----------
+ * Returns 1 if a clue is needed for the solution to be unique, 0 if it
+ * is redundant.
+ *
+ * checkMinimal
+ * ------------
+ * Solve each puzzle, then check every clue of the puzzles with exactly
+ * one solution.  Both steps are spread over threads threads, a puzzle or
+ * a single clue at a time.
+ *
+ * printMinimal
+ * ------------
+ * Print the result of one puzzle: minimal, the redundant clues by row and
+ * column, unsolvable or not unique.
+ *
+ */
+
+#define MINIMAL_UNIQUE		0
+#define MINIMAL_UNSOLVABLE	1
+#define MINIMAL_MULTIPLE	2
+
+typedef struct minimal_puzzle {
+	SuDoku board;
+	SuDoku solution;
+	int status;
+	char redundant[81];	/* row major, 1 where the clue is not needed */
+} minimal_puzzle;
+
+/* Puzzles and the next puzzle and clue for the threads to take */
+typedef struct minimal_work {
+	minimal_puzzle *puzzles;
+	int count;
+	int next_puzzle;
+	long next_clue;
+} minimal_work;
+
+int clueNeeded (solution_iterator*, SuDoku*, int, int);
+void checkMinimal (minimal_puzzle*, int, int);
+void printMinimal (minimal_puzzle*);
+
+int clueNeeded (solution_iterator *iterator, SuDoku *board, int section, int cell) {
+  SuDoku reduced;
+  board_constraint Constraint;
+  int value;
+
+  value = board->section[section].cell[cell];
+  memcpy(&reduced, board, sizeof(SuDoku));
+  placeValue(&reduced, section, cell, 0);
+
+  resetConstraint(&Constraint);
+  dropCandidate(&Constraint, section, cell, value, 0);
+  updateConstraint(&reduced, &Constraint);
+
+  iteratorStartWith(iterator, &reduced, &Constraint);
+  return(iteratorCount(iterator, 1) != 0);
+}
+
+void *minimalSolveWorker (void *threadarg) {
+  minimal_work *work = (minimal_work *) threadarg;
+  minimal_puzzle *puzzle;
+  solution_iterator *iterator;
+  int i;
+
+  iterator = malloc(sizeof(solution_iterator));
+  while ((i = __sync_fetch_and_add(&work->next_puzzle, 1)) < work->count) {
+    puzzle = &work->puzzles[i];
+    memset(puzzle->redundant, 0, sizeof(puzzle->redundant));
+
+    iteratorStart(iterator, &puzzle->board);
+    if (iteratorNext(iterator, &puzzle->solution) == 0) {
+      puzzle->status = MINIMAL_UNSOLVABLE;
+    } else if (iteratorCount(iterator, 1) != 0) {
+      puzzle->status = MINIMAL_MULTIPLE;
+    } else {
+      puzzle->status = MINIMAL_UNIQUE;
+    }
+  }
+  free(iterator);
+  return NULL;
+}
+
+void *minimalClueWorker (void *threadarg) {
+  minimal_work *work = (minimal_work *) threadarg;
+  minimal_puzzle *puzzle;
+  solution_iterator *iterator;
+  long item;
+  int index, section, cell;
+
+  iterator = malloc(sizeof(solution_iterator));
+  while ((item = __sync_fetch_and_add(&work->next_clue, 1)) < (long)work->count * 81) {
+    puzzle = &work->puzzles[item / 81];
+    index = item % 81;
+    section = (index / 27) * 3 + (index % 9) / 3 + 1;
+    cell = ((index / 9) % 3) * 3 + index % 3 + 1;
+
+    if (puzzle->status != MINIMAL_UNIQUE || puzzle->board.section[section].cell[cell] == 0) { continue; }
+    puzzle->redundant[index] = (clueNeeded(iterator, &puzzle->board, section, cell) == 0);
+  }
+  free(iterator);
+  return NULL;
+}
+
+void checkMinimal (minimal_puzzle *puzzles, int count, int threads) {
+  minimal_work work;
+  pthread_t *thread;
+  int i;
+
+  if (unit_count == 0) { loadUnits(); }
+
+  work.puzzles = puzzles;
+  work.count = count;
+  work.next_puzzle = 0;
+  work.next_clue = 0;
+
+  thread = malloc(threads * sizeof(pthread_t));
+  for (i=0; i<threads; i++) {
+    pthread_create(&thread[i], NULL, minimalSolveWorker, &work);
+  }
+  for (i=0; i<threads; i++) {
+    pthread_join(thread[i], NULL);
+  }
+
+  for (i=0; i<threads; i++) {
+    pthread_create(&thread[i], NULL, minimalClueWorker, &work);
+  }
+  for (i=0; i<threads; i++) {
+    pthread_join(thread[i], NULL);
+  }
+  free(thread);
+}
+
+void printMinimal (minimal_puzzle *puzzle) {
+  int index, redundant = 0;
+
+  switch (puzzle->status) {
+    case MINIMAL_UNSOLVABLE:
+      printf("unsolvable\n");
+      return;
+    case MINIMAL_MULTIPLE:
+      printf("not unique\n");
+      return;
+  }
+
+  for (index=0; index<81; index++) {
+    if (puzzle->redundant[index] == 0) { continue; }
+    printf("%s r%dc%d", (redundant == 0) ? "redundant:" : "", index / 9 + 1, index % 9 + 1);
+    redundant++;
+  }
+  printf("%s\n", (redundant == 0) ? "minimal" : "");
+}
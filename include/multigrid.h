@@ -0,0 +1,346 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Multi-grid puzzles, such as the Samurai: several 9x9 grids laid out on
+ * one larger board, overlapping so that some cells belong to more than
+ * one grid.  Each grid keeps its own board and constraint, and the grids
+ * are tied together by the cells they share.  Propagation runs on every
+ * grid, then passes placed values and lost candidates over the shared
+ * cells, and goes round again until nothing changes, so what one grid
+ * learns narrows the others inside the same search.
+ *
+ * A layout file gives the top left cell of each grid on the larger
+ * board, one "grid" line each, followed by the rows of the board.  Cells
+ * are digits, or '.' or '_' when empty, and any other character, such as
+ * a space, is a gap outside every grid.  A Samurai is laid out as:
+ *
+ *   grid r1c1
+ *   grid r1c13
+ *   grid r7c7
+ *   grid r13c1
+ *   grid r13c13
+ *
+ * followed by its 21 rows.  See boards/multigrid/samurai.txt.
+ *
+ * loadMultiGrid
+ * -------------
+ * Read a layout file into a multi_grid and link the shared cells.  Exits
+ * if it cannot be read, or a grid does not fit the rows given.
+ *
+ * propagateMultiGrid
+ * ------------------
+ * Propagate every grid and the shared cells until nothing changes.
+ * Returns 0 if every grid is solved, 1 if some are still open and 2 if
+ * a grid or a shared cell is broken.
+ *
+ * solveMultiGrid
+ * --------------
+ * Search all the grids as one puzzle, branching on the open cell with the
+ * fewest candidates in any grid.  Returns SEARCH_SOLVED with the solution
+ * in the grids, SEARCH_ABORTED if the search budget ran out and
+ * SEARCH_CONTINUE if there is no solution.
+ *
+ * printMultiGrid
+ * --------------
+ * Print the larger board in the layout of the file, without the grid
+ * lines and with gaps as spaces.
+ *
+ */
+
+#define MAX_GRIDS	8
+#define MULTI_SIZE	45	/* rows and columns of the larger board */
+
+/* A cell two grids share, as it is addressed in each */
+typedef struct grid_link {
+	int a;
+	int b;
+	c_address a_cell;
+	c_address b_cell;
+} grid_link;
+
+typedef struct multi_grid {
+	int count;
+	int row[MAX_GRIDS];		/* top left cell of each grid on the larger board, from 0 */
+	int col[MAX_GRIDS];
+	SuDoku board[MAX_GRIDS];
+	board_constraint constraint[MAX_GRIDS];
+} multi_grid;
+
+grid_link grid_links[MAX_GRIDS * MAX_GRIDS * 81];
+int grid_link_count = 0;
+int multi_rows = 0;
+int multi_cols = 0;
+
+void loadMultiGrid (multi_grid*, char*);
+int propagateMultiGrid (multi_grid*);
+int solveMultiGrid (multi_grid*, search_state*);
+void printMultiGrid (multi_grid*);
+
+c_address gridCell (multi_grid *multi, int g, int row, int col) {
+/*
+ * The section and cell of grid g at a row and column of the larger
+ * board, section 0 if the grid does not cover it.
+ *
+ */
+
+  c_address theCell;
+
+  row -= multi->row[g];
+  col -= multi->col[g];
+  theCell.value = 0;
+  if (row < 0 || row > 8 || col < 0 || col > 8) {
+    theCell.section = 0;
+    theCell.cell = 0;
+    return(theCell);
+  }
+  theCell.section = (row/3)*3 + col/3 + 1;
+  theCell.cell = (row%3)*3 + col%3 + 1;
+  return(theCell);
+}
+
+void linkGrids (multi_grid *multi) {
+  grid_link *link;
+  int a,b,row,col;
+
+  grid_link_count = 0;
+  for (a=0; a<multi->count; a++) {
+    for (b=a+1; b<multi->count; b++) {
+      for (row=0; row<9; row++) {
+        for (col=0; col<9; col++) {
+          link = &grid_links[grid_link_count];
+          link->a_cell = gridCell(multi, a, multi->row[a] + row, multi->col[a] + col);
+          link->b_cell = gridCell(multi, b, multi->row[a] + row, multi->col[a] + col);
+          if (link->b_cell.section == 0) { continue; }
+
+          link->a = a;
+          link->b = b;
+          grid_link_count++;
+        }
+      }
+    }
+  }
+}
+
+void loadMultiGrid (multi_grid *multi, char *fname) {
+  FILE *fin;
+  char line[1024], rows[MULTI_SIZE][MULTI_SIZE + 2];
+  int row, col, count = 0;
+  int g,i,j,value;
+  c_address theCell;
+
+  loadUnits();
+  memset(multi, 0, sizeof(multi_grid));
+
+  if ( strncmp("-", fname, 1) == 0) {
+    fin = fdopen(dup(STDIN_FILENO), "r");
+  } else {
+    fin = fopen(fname, "rb");
+  }
+  if ( fin == NULL ) {
+    printf ("Error: could not open '%s'\n", fname);
+    exit(1);
+  }
+
+  while (fgets(line, sizeof(line), fin) != NULL) {
+    if (strncmp("grid", line, 4) == 0) {
+      if (sscanf(line, "grid r%dc%d", &row, &col) != 2 || row < 1 || col < 1 || row + 8 > MULTI_SIZE || col + 8 > MULTI_SIZE) {
+        printf("Error: bad grid line '%s' in '%s'\n", strtok(line, "\r\n"), fname);
+        exit(1);
+      }
+      if (multi->count == MAX_GRIDS) {
+        printf("Error: more than %d grids in '%s'\n", MAX_GRIDS, fname);
+        exit(1);
+      }
+      multi->row[multi->count] = row - 1;
+      multi->col[multi->count] = col - 1;
+      multi->count++;
+      continue;
+    }
+    if (strpbrk(line, "0123456789._") == NULL) { continue; }
+
+    if (count == MULTI_SIZE) {
+      printf("Error: more than %d rows in '%s'\n", MULTI_SIZE, fname);
+      exit(1);
+    }
+    line[strcspn(line, "\r\n")] = '\0';
+    if (strlen(line) > MULTI_SIZE) {
+      printf("Error: row %d of '%s' is wider than %d cells\n", count + 1, fname, MULTI_SIZE);
+      exit(1);
+    }
+    strcpy(rows[count++], line);
+  }
+  fclose(fin);
+
+  if (multi->count == 0) {
+    printf("Error: no grid lines in '%s'\n", fname);
+    exit(1);
+  }
+
+ /* Every cell of every grid has to be a cell on the board */
+  multi_rows = 0;
+  multi_cols = 0;
+  for (g=0; g<multi->count; g++) {
+    resetBoard(&multi->board[g]);
+    for (i=0; i<9; i++) {
+      row = multi->row[g] + i;
+      for (j=0; j<9; j++) {
+        col = multi->col[g] + j;
+        value = (row < count && col < (int)strlen(rows[row])) ? rows[row][col] : ' ';
+        if (value != '.' && value != '_' && (value < '0' || value > '9')) {
+          printf("Error: grid %d of '%s' has no cell at r%dc%d\n", g + 1, fname, row + 1, col + 1);
+          exit(1);
+        }
+        if (value == '.' || value == '_') { value = '0'; }
+
+        theCell = gridCell(multi, g, row, col);
+        multi->board[g].section[theCell.section].cell[theCell.cell] = value - '0';
+      }
+    }
+    multi->board[g].hash = boardHash(&multi->board[g]);
+    if (multi->row[g] + 9 > multi_rows) { multi_rows = multi->row[g] + 9; }
+    if (multi->col[g] + 9 > multi_cols) { multi_cols = multi->col[g] + 9; }
+  }
+
+  linkGrids(multi);
+}
+
+int syncCell (multi_grid *multi, int x, c_address p, int y, c_address q) {
+/*
+ * Pass what grid x knows of a shared cell on to grid y.  Returns how
+ * many changes were made, or -1 if the two cannot agree.
+ *
+ */
+
+  int k, from, to, changed = 0;
+
+  from = multi->board[x].section[p.section].cell[p.cell];
+  to = multi->board[y].section[q.section].cell[q.cell];
+
+  if (from != 0) {
+    if (to == from) { return(0); }
+    if (to != 0 || multi->constraint[y].section[q.section].cell[q.cell].value[from] == 0) { return(-1); }
+    placeValue(&multi->board[y], q.section, q.cell, from);
+    return(1);
+  }
+  if (to != 0) { return(0); }
+
+  for (k=1; k<=9; k++) {
+    if (multi->constraint[x].section[p.section].cell[p.cell].value[k] == 0 &&
+        multi->constraint[y].section[q.section].cell[q.cell].value[k] == 1) {
+      dropCandidate(&multi->constraint[y], q.section, q.cell, k, multi->constraint[x].why[p.section][p.cell]);
+      changed++;
+    }
+  }
+  return(changed);
+}
+
+int propagateMultiGrid (multi_grid *multi) {
+  grid_link *link;
+  int g, i, open, changed, a_to_b, b_to_a;
+
+  do {
+    open = 0;
+    for (g=0; g<multi->count; g++) {
+      if (scanBoard(&multi->board[g], &multi->constraint[g]) != 0) {
+        if (checkConstraintRules(&multi->board[g], &multi->constraint[g]) == 1) { return(2); }
+        open = 1;
+      }
+      if (checkRules(&multi->board[g]) != 0) { return(2); }
+    }
+
+    changed = 0;
+    for (i=0; i<grid_link_count; i++) {
+      link = &grid_links[i];
+      a_to_b = syncCell(multi, link->a, link->a_cell, link->b, link->b_cell);
+      b_to_a = syncCell(multi, link->b, link->b_cell, link->a, link->a_cell);
+      if (a_to_b < 0 || b_to_a < 0) { return(2); }
+      changed += a_to_b + b_to_a;
+    }
+  } while (changed != 0);
+
+  return(open);
+}
+
+int searchMultiGrid (multi_grid *multi, search_state *search) {
+  multi_grid *next;
+  c_address move, best;
+  int g, k, best_grid = 0, best_count = 10, result;
+
+  if (searchExpired(search) != 0) {
+    return(SEARCH_ABORTED);
+  }
+
+  result = propagateMultiGrid(multi);
+  if (result == 0) {
+    return(SEARCH_SOLVED);
+  }
+  if (result == 2) {
+    __sync_add_and_fetch(&search->dead_ends, 1);
+    return(SEARCH_CONTINUE);
+  }
+
+ /* The cell with the fewest candidates of any grid */
+  best.section = 0;
+  for (g=0; g<multi->count; g++) {
+    move = findLeastConstrained(&multi->board[g], &multi->constraint[g]);
+    if (move.section == 0 || multi->constraint[g].candidates[move.section][move.cell] >= best_count) { continue; }
+    best = move;
+    best_grid = g;
+    best_count = multi->constraint[g].candidates[move.section][move.cell];
+  }
+  if (best.section == 0) {
+    __sync_add_and_fetch(&search->dead_ends, 1);
+    return(SEARCH_CONTINUE);
+  }
+
+  next = malloc(sizeof(multi_grid));
+  for (k=1; k<=9; k++) {
+    if (multi->constraint[best_grid].section[best.section].cell[best.cell].value[k] == 0) { continue; }
+
+    memcpy(next, multi, sizeof(multi_grid));
+    placeValue(&next->board[best_grid], best.section, best.cell, k);
+    result = searchMultiGrid(next, search);
+    if (result != SEARCH_CONTINUE) {
+      if (result == SEARCH_SOLVED) { memcpy(multi, next, sizeof(multi_grid)); }
+      free(next);
+      return(result);
+    }
+  }
+  free(next);
+
+  return(SEARCH_CONTINUE);
+}
+
+int solveMultiGrid (multi_grid *multi, search_state *search) {
+  int g;
+
+  for (g=0; g<multi->count; g++) {
+    resetConstraint(&multi->constraint[g]);
+    updateConstraint(&multi->board[g], &multi->constraint[g]);
+  }
+  return(searchMultiGrid(multi, search));
+}
+
+void printMultiGrid (multi_grid *multi) {
+  char line[MULTI_SIZE + 1];
+  c_address theCell;
+  int g, row, col, value, end;
+
+  for (row=0; row<multi_rows; row++) {
+    memset(line, ' ', sizeof(line));
+    end = 0;
+    for (col=0; col<multi_cols; col++) {
+      for (g=0; g<multi->count; g++) {
+        theCell = gridCell(multi, g, row, col);
+        if (theCell.section == 0) { continue; }
+
+        value = multi->board[g].section[theCell.section].cell[theCell.cell];
+        line[col] = (value == 0) ? '.' : '0' + value;
+        end = col + 1;
+        break;
+      }
+    }
+    line[end] = '\0';
+    printf("%s\n", line);
+  }
+}
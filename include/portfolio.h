@@ -0,0 +1,195 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Portfolio solving.  Several differently configured searches of one
+ * puzzle race each other, one process each, and the first answer wins.
+ *
+ * Member 0 is the usual search, so the common case is never slower than
+ * running it alone.  Members 1 and 2 change the value order and the cell
+ * heuristic, and every member after that uses random value order and
+ * random tie breaks with its own seed, restarting on a growing node budget.
+ *
+ * portfolioMember
+ * ---------------
+ * Set the heuristics of member n on a search.  Returns 1 if the member
+ * uses restarts.
+ *
+ * restartSearch
+ * -------------
+ * Search with random restarts.  Each restart gets a fresh seed and a node
+ * budget following the Luby sequence, all within the limits of search.
+ *
+ * solvePortfolio
+ * --------------
+ * Fork one process per member and wait for the first solution, then
+ * terminate the others.  A member that finishes without a solution proves
+ * there is none, which also ends the race.  Returns the winning member
+ * with the solution copied onto board, or -1 if there is none.  search
+ * holds the limits for each member and gets the totals of the members
+ * that reported.
+ *
+ */
+
+#define RESTART_NODES 32
+
+/* What one member reports back through the pipe */
+typedef struct portfolio_result {
+	int member;
+	int status;
+	long nodes;
+	long dead_ends;
+	SuDoku board;
+} portfolio_result;
+
+/* A member's report fits in one atomic pipe write, so racing members never interleave */
+_Static_assert(sizeof(portfolio_result) <= PIPE_BUF, "portfolio_result must fit in one atomic pipe write");
+
+SuDoku portfolio_solution;
+
+int portfolioMember (search_state*, int);
+int restartSearch (SuDoku*, board_constraint*, search_state*);
+int solvePortfolio (SuDoku*, int, search_state*);
+
+void portfolioSolutionFunc (SuDoku *board) {
+  memcpy(&portfolio_solution, board, sizeof(SuDoku));
+}
+
+int portfolioMember (search_state *search, int member) {
+  switch (member) {
+    case 0:
+      configureSearch(search, BRANCH_LEAST, VALUES_ASCENDING, 0, 0);
+      return(0);
+
+    case 1:
+      configureSearch(search, BRANCH_LEAST, VALUES_DESCENDING, 0, 0);
+      return(0);
+
+    case 2:
+      configureSearch(search, BRANCH_MOST, VALUES_ASCENDING, 0, 0);
+      return(0);
+  }
+
+  configureSearch(search, BRANCH_LEAST, VALUES_RANDOM, 1, member);
+  return(1);
+}
+
+long luby (long i) {
+/*
+ * The i'th term, counting from 1, of 1 1 2 1 1 2 4 1 1 2 1 1 2 4 8 ...
+ *
+ */
+
+  long k = 1;
+
+  while ((1L << k) - 1 < i) { k++; }
+  while (i != (1L << k) - 1) {
+    i -= (1L << (k-1)) - 1;
+    k = 1;
+    while ((1L << k) - 1 < i) { k++; }
+  }
+  return(1L << (k-1));
+}
+
+int restartSearch (SuDoku *board, board_constraint *constraint, search_state *search) {
+  SuDoku newBoard;
+  board_constraint newConstraint;
+  search_state run;
+  long budget, elapsed, restart;
+  int result;
+
+  for (restart=1; ; restart++) {
+    budget = luby(restart) * RESTART_NODES;
+    if (search->node_limit != 0) {
+      if (search->nodes >= search->node_limit) { break; }
+      if (budget > search->node_limit - search->nodes) { budget = search->node_limit - search->nodes; }
+    }
+
+    elapsed = searchElapsed(search);
+    if (search->time_limit != 0 && elapsed >= search->time_limit) { break; }
+
+    resetSearch(&run, budget, (search->time_limit != 0) ? search->time_limit - elapsed : 0);
+    configureSearch(&run, search->branch, search->values, search->random_ties, search->seed * 7919 + restart);
+
+    memcpy(&newBoard, board, sizeof(SuDoku));
+    memcpy(&newConstraint, constraint, sizeof(board_constraint));
+    result = constraintPropagation(&newBoard, &newConstraint, chooseMove(&newBoard, &newConstraint, &run), portfolioSolutionFunc, &run);
+
+    search->nodes += run.nodes;
+    search->dead_ends += run.dead_ends;
+    search->backjumps += run.backjumps;
+    if (result != SEARCH_ABORTED) {
+      return(result);
+    }
+  }
+
+  search->aborted = 1;
+  return(SEARCH_ABORTED);
+}
+
+int solvePortfolio (SuDoku *board, int members, search_state *search) {
+  board_constraint Constraint;
+  portfolio_result result;
+  pid_t *children;
+  int fd[2], i, reported, winner = -1;
+
+  if (pipe(fd) != 0) {
+    printf("Error: could not create portfolio pipe\n");
+    exit(1);
+  }
+
+  fflush(stdout);
+  children = malloc(members * sizeof(pid_t));
+  for (i=0; i<members; i++) {
+    children[i] = fork();
+    if (children[i] == 0) {
+      close(fd[0]);
+
+      result.member = i;
+      resetConstraint(&Constraint);
+      updateConstraint(board, &Constraint);
+      if (portfolioMember(search, i) != 0) {
+        result.status = restartSearch(board, &Constraint, search);
+      } else {
+        result.status = constraintPropagation(board, &Constraint, chooseMove(board, &Constraint, search), portfolioSolutionFunc, search);
+      }
+      result.nodes = search->nodes;
+      result.dead_ends = search->dead_ends;
+      memcpy(&result.board, &portfolio_solution, sizeof(SuDoku));
+
+     /* _exit: exit would reset the offsets of stdio streams the parent shares, such as a -W worker's input */
+      if (write(fd[1], &result, sizeof(result)) != sizeof(result)) {
+        _exit(1);
+      }
+      _exit(0);
+    }
+  }
+  close(fd[1]);
+
+  search->nodes = 0;
+  search->dead_ends = 0;
+  for (reported=0; reported<members && read(fd[0], &result, sizeof(result)) == sizeof(result); reported++) {
+    search->nodes += result.nodes;
+    search->dead_ends += result.dead_ends;
+    if (result.status == SEARCH_ABORTED) {
+      search->aborted = 1;
+    }
+    if (result.status == SEARCH_SOLVED) {
+      winner = result.member;
+      memcpy(board, &result.board, sizeof(SuDoku));
+      break;
+    }
+    if (result.status == SEARCH_CONTINUE) {	/* a finished search proves there is no solution */
+      search->aborted = 0;
+      break;
+    }
+  }
+  close(fd[0]);
+
+  for (i=0; i<members; i++) {
+    kill(children[i], SIGTERM);
+    waitpid(children[i], NULL, 0);
+  }
+  free(children);
+
+  return(winner);
+}
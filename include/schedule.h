@@ -0,0 +1,389 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Hardest first scheduling of benchmark runs.  With byte range shards a
+ * single monster puzzle near the end of a range can keep its worker busy
+ * long after the others are idle.  Here the whole file is read first and
+ * each puzzle's search tree is estimated, then the puzzles are handed out
+ * one at a time, largest estimate first, to whichever worker is free.
+ * The long searches start early and the cheap ones fill in around them.
+ *
+ * The estimate is Knuth's: follow a random path down the search tree,
+ * propagating and branching on the cell with the fewest candidates as
+ * the search does, and add up the product of the branching factors seen
+ * at each depth.  Its expected value is the size of the tree.  A probe
+ * costs a few propagations per level, about a fifth of solving a Top95
+ * puzzle, so one or two probes are the useful range, and the estimates
+ * are spread over the workers before the first puzzle is handed out.
+ *
+ * The puzzles are triaged as they are read: those propagation finishes
+ * are done there and then, and only the rest are estimated and queued,
+ * their boards as far as propagation got going down the workers' pipes
+ * with the -A strategy of the puzzle as it was given.
+ *
+ * Results are still passed on in input order, each one held until every
+ * puzzle before it has finished.  A worker that dies is started again
+ * and its puzzle handed out once more; a puzzle two workers died on is
+ * reported as crashed.
+ *
+ * estimateCost
+ * ------------
+ * The mean search tree size of probes random probes of a board, at least
+ * one.
+ *
+ * runScheduled
+ * ------------
+ * Solve every puzzle of a benchmark file on workers worker processes,
+ * hardest first by estimates of probes probes each, with the limits of
+ * search or racing members searches of every puzzle if members is more
+ * than one.  Each result is passed to the handler in input order, and
+ * the totals are added up in stats.
+ *
+ */
+
+/* A puzzle of the file, and its result once a worker has reported it */
+typedef struct scheduled_puzzle {
+	SuDoku board;		/* as far as triage got */
+	int strategy;		/* of the puzzle before triage, with -A */
+	double cost;
+	int tries;
+	shard_result *result;
+} scheduled_puzzle;
+
+/* A worker and the puzzle it is solving, -1 when idle */
+typedef struct schedule_worker {
+	pid_t pid;
+	int command;		/* boards to solve go down this pipe */
+	int results;
+	int puzzle;
+	int done;
+} schedule_worker;
+
+scheduled_puzzle *schedule_puzzles;
+
+double estimateCost (SuDoku*, int);
+void runScheduled (char*, int, search_state*, int, int, shard_handler, shard_stats*);
+
+double estimateCost (SuDoku *board, int probes) {
+  SuDoku probeBoard;
+  board_constraint Constraint;
+  c_address move;
+  double size, width, total = 0;
+  int p, k, depth, count, pick;
+
+  if (probes < 1) { probes = 1; }
+  for (p=0; p<probes; p++) {
+    memcpy(&probeBoard, board, sizeof(SuDoku));
+    resetConstraint(&Constraint);
+    updateConstraint(&probeBoard, &Constraint);
+
+    size = 1;
+    width = 1;
+    for (depth=0; scanBoard(&probeBoard, &Constraint) != 0; depth++) {
+      updateConstraint(&probeBoard, &Constraint);
+      if (checkConstraintRules(&probeBoard, &Constraint) == 1) { break; }
+      move = findLeastConstrained(&probeBoard, &Constraint);
+      if (move.section == 0) { break; }
+
+      count = 0;
+      for (k=1; k<=9; k++) {
+        count += Constraint.section[move.section].cell[move.cell].value[k];
+      }
+      width *= count;
+      size += width;
+
+     /* Follow a random candidate of the cell down */
+      pick = searchHash(p, depth, cellIndex(move.section, move.cell)) % count;
+      for (k=1; k<=9; k++) {
+        if (Constraint.section[move.section].cell[move.cell].value[k] == 0) { continue; }
+        if (pick-- == 0) { break; }
+      }
+      placeValue(&probeBoard, move.section, move.cell, k);
+    }
+    total += size;
+  }
+
+  return(total / probes);
+}
+
+int scheduleCompare (const void *a, const void *b) {
+/*
+ * Larger estimates first, and the input order between equal ones.
+ *
+ */
+
+  int x = *(const int *)a, y = *(const int *)b;
+
+  if (schedule_puzzles[x].cost != schedule_puzzles[y].cost) {
+    return((schedule_puzzles[x].cost < schedule_puzzles[y].cost) ? 1 : -1);
+  }
+  return(x - y);
+}
+
+void scheduleWorker (int index, int command, int results, search_state *limits, int members) {
+/*
+ * Solve each board and strategy read from the command pipe, until it is
+ * closed.
+ *
+ */
+
+  shard_result result;
+
+  memset(&result, 0, sizeof(result));
+  while (read(command, &result, sizeof(result)) == sizeof(result)) {
+    telemetryBegin(index);
+    shardSolve(&result, limits, members);
+    telemetryEnd(index);
+    telemetryResult(index, result.status);
+    if (write(results, &result, sizeof(result)) != sizeof(result)) {
+      exit(1);
+    }
+  }
+
+  exit(0);
+}
+
+void scheduleStart (schedule_worker *workers, int n, int count, search_state *limits, int members) {
+  int command[2], results[2];
+  int i;
+
+  if (pipe(command) != 0 || pipe(results) != 0) {
+    printf("Error: could not create worker pipes\n");
+    exit(1);
+  }
+
+  fflush(stdout);
+  workers[n].pid = fork();
+  if (workers[n].pid == 0) {
+
+   /* A sibling's command pipe held open here would never let it see the end */
+    for (i=0; i<count; i++) {
+      if (i != n && workers[i].done == 0 && workers[i].pid > 0) {
+        close(workers[i].command);
+        close(workers[i].results);
+      }
+    }
+    close(command[1]);
+    close(results[0]);
+    scheduleWorker(n, command[0], results[1], limits, members);
+  }
+  if (workers[n].pid == -1) {
+    printf("Error: could not start worker\n");
+    exit(1);
+  }
+
+  close(command[0]);
+  close(results[1]);
+  workers[n].command = command[1];
+  workers[n].results = results[0];
+  workers[n].puzzle = -1;
+  workers[n].done = 0;
+}
+
+int loadSchedule (char *fname) {
+/*
+ * Read every puzzle of the file into schedule_puzzles, returning how many
+ * there are.  The result of a puzzle triage solves is filled in straight
+ * away.
+ *
+ */
+
+  shard_result result;
+  FILE *fin;
+  int count = 0, size = 0;
+
+  fin = fopen(fname, "rb");
+  if (fin == NULL) {
+    printf("Error: could not open '%s'\n", fname);
+    exit(1);
+  }
+
+  schedule_puzzles = NULL;
+  memset(&result, 0, sizeof(result));
+  while (loadBenchmark(&result.board, fin) == 0) {
+    if (count == size) {
+      size = size * 2 + 256;
+      schedule_puzzles = realloc(schedule_puzzles, size * sizeof(scheduled_puzzle));
+    }
+    schedule_puzzles[count].cost = 0;
+    schedule_puzzles[count].tries = 0;
+    schedule_puzzles[count].result = NULL;
+
+    telemetryBegin(0);
+    if (shardTriage(&result) == 0) {
+      telemetryEnd(0);
+      schedule_puzzles[count].result = malloc(sizeof(shard_result));
+      memcpy(schedule_puzzles[count].result, &result, sizeof(shard_result));
+    } else {
+      telemetryIdle(0);
+    }
+    memcpy(&schedule_puzzles[count].board, &result.board, sizeof(SuDoku));
+    schedule_puzzles[count].strategy = result.strategy;
+    count++;
+  }
+  fclose(fin);
+
+  return(count);
+}
+
+void estimateSchedule (int count, int workers, int probes) {
+/*
+ * Estimate every puzzle, spread over workers processes that write into
+ * shared memory.  A puzzle whose estimate crashed its process keeps a
+ * cost of zero and is simply scheduled last.
+ *
+ */
+
+  double *cost;
+  pid_t *pid;
+  int i, n;
+
+  cost = mmap(NULL, (count + 1) * sizeof(double), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (cost == MAP_FAILED) {
+    printf("Error: could not map the estimates\n");
+    exit(1);
+  }
+  memset(cost, 0, (count + 1) * sizeof(double));
+
+  fflush(stdout);
+  pid = malloc(workers * sizeof(pid_t));
+  for (n=0; n<workers; n++) {
+    pid[n] = fork();
+    if (pid[n] == 0) {
+      for (i=n; i<count; i+=workers) {
+        if (schedule_puzzles[i].result != NULL) { continue; }
+        cost[i] = estimateCost(&schedule_puzzles[i].board, probes);
+      }
+      exit(0);
+    }
+  }
+  for (n=0; n<workers; n++) {
+    if (pid[n] > 0) { waitpid(pid[n], NULL, 0); }
+  }
+
+  for (i=0; i<count; i++) {
+    schedule_puzzles[i].cost = cost[i];
+  }
+  munmap(cost, (count + 1) * sizeof(double));
+  free(pid);
+}
+
+void runScheduled (char *fname, int workers, search_state *limits, int members, int probes, shard_handler handler, shard_stats *stats) {
+  schedule_worker *worker;
+  scheduled_puzzle *puzzle;
+  shard_result result, job;
+  struct pollfd *polls;
+  int *order, *retry;
+  int count, waiting = 0, queued = 0, retries = 0, delivered = 0, running;
+  int i, n, polled, status;
+
+  if (unit_count == 0) { loadUnits(); }
+  count = loadSchedule(fname);
+  estimateSchedule(count, workers, probes);
+  memset(stats, 0, sizeof(shard_stats));
+
+  order = malloc((count + 1) * sizeof(int));
+  for (i=0; i<count; i++) {
+    if (schedule_puzzles[i].result == NULL) { order[waiting++] = i; }
+  }
+  qsort(order, waiting, sizeof(int), scheduleCompare);
+
+  memset(&job, 0, sizeof(job));
+  signal(SIGPIPE, SIG_IGN);	/* a dead worker shows up as the end of its results */
+  retry = malloc(workers * sizeof(int));
+  worker = calloc(workers, sizeof(schedule_worker));
+  polls = malloc(workers * sizeof(struct pollfd));
+  for (n=0; n<workers; n++) {
+    scheduleStart(worker, n, workers, limits, members);
+  }
+
+  running = workers;
+  while (running > 0) {
+
+   /* Hand the retries, then the hardest puzzles left, to the idle workers */
+    for (n=0; n<workers; n++) {
+      if (worker[n].done != 0 || worker[n].puzzle != -1) { continue; }
+      if (retries > 0) {
+        worker[n].puzzle = retry[--retries];
+      } else if (queued < waiting) {
+        worker[n].puzzle = order[queued++];
+      } else {
+        close(worker[n].command);
+        worker[n].command = -1;
+        continue;
+      }
+      memcpy(&job.board, &schedule_puzzles[ worker[n].puzzle ].board, sizeof(SuDoku));
+      job.strategy = schedule_puzzles[ worker[n].puzzle ].strategy;
+
+     /* A worker that cannot take its board is dead to us, and the end of its results requeues the puzzle */
+      if (write(worker[n].command, &job, sizeof(job)) != sizeof(job)) {
+        kill(worker[n].pid, SIGKILL);
+      }
+    }
+    telemetryQueued(waiting - queued + retries);
+
+    polled = 0;
+    for (n=0; n<workers; n++) {
+      if (worker[n].done != 0) { continue; }
+      polls[polled].fd = worker[n].results;
+      polls[polled].events = POLLIN;
+      polled++;
+    }
+    if (poll(polls, polled, -1) < 0) {
+      if (errno == EINTR) { continue; }
+      printf("Error: could not poll the workers\n");
+      exit(1);
+    }
+
+    polled = 0;
+    for (n=0; n<workers; n++) {
+      if (worker[n].done != 0) { continue; }
+      if (polls[polled++].revents == 0) { continue; }
+
+      if (read(worker[n].results, &result, sizeof(result)) == sizeof(result)) {
+        puzzle = &schedule_puzzles[ worker[n].puzzle ];
+        puzzle->result = malloc(sizeof(shard_result));
+        memcpy(puzzle->result, &result, sizeof(shard_result));
+        worker[n].puzzle = -1;
+        continue;
+      }
+
+     /* The worker is gone, cleanly once it had nothing left to do */
+      close(worker[n].results);
+      if (worker[n].command != -1) { close(worker[n].command); }
+      waitpid(worker[n].pid, &status, 0);
+      if (worker[n].puzzle == -1 && worker[n].command == -1) {
+        worker[n].done = 1;
+        running--;
+        continue;
+      }
+
+      stats->restarts++;
+      if (worker[n].puzzle != -1) {
+        puzzle = &schedule_puzzles[ worker[n].puzzle ];
+        if (++puzzle->tries < SHARD_TRIES) {
+          retry[retries++] = worker[n].puzzle;
+        } else {
+          puzzle->result = calloc(1, sizeof(shard_result));
+          puzzle->result->status = SHARD_CRASHED;
+        }
+      }
+      scheduleStart(worker, n, workers, limits, members);
+    }
+
+   /* Pass on every result whose turn has come */
+    while (delivered < count && schedule_puzzles[delivered].result != NULL) {
+      puzzle = &schedule_puzzles[delivered];
+      shardCount(stats, puzzle->result);
+      handler(puzzle->result);
+      free(puzzle->result);
+      delivered++;
+    }
+  }
+
+  free(schedule_puzzles);
+  free(order);
+  free(retry);
+  free(worker);
+  free(polls);
+}
@@ -0,0 +1,290 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Incremental play session for serving hints and checks while a player
+ * fills in a board.
+ *
+ * The session keeps, for every cell and value, how many of the cell's
+ * peers (the cells sharing a unit with it) hold the value.  A value is
+ * a candidate of an empty cell while that count is zero.  Placing or
+ * erasing a value only touches the counts of its peers, so erasing puts
+ * back exactly the candidates the value had taken away.
+ *
+ * sessionStart
+ * ------------
+ * Start a session on a board.  Its filled cells become the clues, which
+ * cannot be changed.
+ *
+ * sessionPlace
+ * ------------
+ * Set a cell to a value, or erase it with value 0, and record the move
+ * for undo.  Returns 1 if the cell is a clue or out of range, 0 otherwise.
+ *
+ * sessionUndo
+ * -----------
+ * Take back the last move.  Returns 1 if there is nothing to undo.
+ *
+ * sessionHint
+ * -----------
+ * The next logical step: an empty cell with one candidate (naked single),
+ * or a value with one place left in a unit (hidden single).  Returns a
+ * move with value 0 if there is neither.
+ *
+ * sessionConflicts
+ * ----------------
+ * Fill a list with every cell whose value is also held by a peer.
+ * Returns the number of cells.
+ *
+ * sessionSolvable
+ * ---------------
+ * Returns SESSION_SOLVABLE, SESSION_UNSOLVABLE, or SESSION_UNKNOWN if the
+ * search ran out of nodes.  The last solution found is kept, so while the
+ * player's moves agree with it no search is needed.  A node_limit of zero
+ * uses SESSION_NODES.
+ *
+ */
+
+#define SESSION_SOLVABLE	0
+#define SESSION_UNSOLVABLE	1
+#define SESSION_UNKNOWN		2
+
+/* Default node budget of sessionSolvable */
+#define SESSION_NODES	100000
+
+#define HINT_NONE	0
+#define HINT_NAKED	1
+#define HINT_HIDDEN	2
+
+/* A move as it was made, so it can be undone */
+typedef struct session_move {
+	int section;
+	int cell;
+	int old_value;
+} session_move;
+
+/* The board of a session and its incremental candidate state */
+typedef struct sudoku_session {
+	SuDoku board;
+	SuDoku clues;
+	SuDoku solution;
+	int have_solution;
+	int peer_count[10][10][10];	/* peers of section, cell holding value */
+	session_move *history;
+	int history_count;
+	int history_size;
+} sudoku_session;
+
+/* Where sessionSolvable's search leaves its answer */
+SuDoku session_found;
+
+void sessionStart (sudoku_session*, SuDoku*);
+int sessionPlace (sudoku_session*, int, int, int);
+int sessionUndo (sudoku_session*);
+c_address sessionHint (sudoku_session*, int*);
+int sessionConflicts (sudoku_session*, c_address*);
+int sessionSolvable (sudoku_session*, long);
+
+void sessionSet (sudoku_session *session, int section, int cell, int value) {
+/*
+ * Change one cell and the peer counts of its old and new value.
+ *
+ */
+
+  c_address *peer;
+  int old_value, i;
+
+  old_value = session->board.section[section].cell[cell];
+  for (i=0; i<cell_peer_count[section][cell]; i++) {
+    peer = &cell_peers[section][cell][i];
+    if (old_value != 0) { session->peer_count[peer->section][peer->cell][old_value]--; }
+    if (value != 0) { session->peer_count[peer->section][peer->cell][value]++; }
+  }
+  placeValue(&session->board, section, cell, value);
+}
+
+void sessionStart (sudoku_session *session, SuDoku *board) {
+  int i,j;
+
+  if (unit_count == 0) { loadUnits(); }
+
+  memset(session->peer_count, 0, sizeof(session->peer_count));
+  resetBoard(&session->board);
+  memcpy(&session->clues, board, sizeof(SuDoku));
+  for (i=1; i<=9; i++) {
+    for (j=1; j<=9; j++) {
+      if (board->section[i].cell[j] != 0) {
+        sessionSet(session, i, j, board->section[i].cell[j]);
+      }
+    }
+  }
+
+  memset(&session->solution, 0, sizeof(SuDoku));
+  session->have_solution = 0;
+  session->history = NULL;
+  session->history_count = 0;
+  session->history_size = 0;
+}
+
+int sessionPlace (sudoku_session *session, int section, int cell, int value) {
+  session_move *move;
+
+  if (section < 1 || section > 9 || cell < 1 || cell > 9 || value < 0 || value > 9) { return(1); }
+  if (session->clues.section[section].cell[cell] != 0) { return(1); }
+
+  if (session->history_count == session->history_size) {
+    session->history_size = session->history_size * 2 + 64;
+    session->history = realloc(session->history, session->history_size * sizeof(session_move));
+  }
+  move = &session->history[session->history_count++];
+  move->section = section;
+  move->cell = cell;
+  move->old_value = session->board.section[section].cell[cell];
+
+  sessionSet(session, section, cell, value);
+  return(0);
+}
+
+int sessionUndo (sudoku_session *session) {
+  session_move *move;
+
+  if (session->history_count == 0) { return(1); }
+
+  move = &session->history[--session->history_count];
+  sessionSet(session, move->section, move->cell, move->old_value);
+  return(0);
+}
+
+int sessionCandidates (sudoku_session *session, int section, int cell) {
+/*
+ * Candidates of a cell as a bit mask, bit k-1 for value k.
+ *
+ */
+
+  int k, mask = 0;
+
+  if (session->board.section[section].cell[cell] != 0) { return(0); }
+  for (k=1; k<=9; k++) {
+    if (session->peer_count[section][cell][k] == 0) { mask |= 1 << (k-1); }
+  }
+  return(mask);
+}
+
+c_address sessionHint (sudoku_session *session, int *technique) {
+  c_address unit[9], theMove;
+  int mask[9], once, twice, only;
+  int i,j,k,u,value;
+
+  theMove.section = 0;
+  theMove.cell = 0;
+  theMove.value = 0;
+  *technique = HINT_NONE;
+
+ /* Naked singles */
+  for (i=1; i<=9; i++) {
+    for (j=1; j<=9; j++) {
+      mask[0] = sessionCandidates(session, i, j);
+      if (mask[0] != 0 && (mask[0] & (mask[0] - 1)) == 0) {
+        for (value=1; (mask[0] >> (value-1)) != 1; value++);
+        theMove.section = i;
+        theMove.cell = j;
+        theMove.value = value;
+        *technique = HINT_NAKED;
+        return(theMove);
+      }
+    }
+  }
+
+ /* Hidden singles in each unit */
+  for (u=0; u<unit_count; u++) {
+    for (k=0; k<9; k++) {
+      unit[k] = units[u][k];
+    }
+
+    once = 0;
+    twice = 0;
+    for (k=0; k<9; k++) {
+      mask[k] = sessionCandidates(session, unit[k].section, unit[k].cell);
+      twice |= once & mask[k];
+      once |= mask[k];
+    }
+    only = once & ~twice;
+    if (only == 0) { continue; }
+
+    for (k=0; k<9; k++) {
+      if ((mask[k] & only) != 0) {
+        for (value=1; ((mask[k] & only) >> (value-1) & 1) == 0; value++);
+        theMove.section = unit[k].section;
+        theMove.cell = unit[k].cell;
+        theMove.value = value;
+        *technique = HINT_HIDDEN;
+        return(theMove);
+      }
+    }
+  }
+
+  return(theMove);
+}
+
+int sessionConflicts (sudoku_session *session, c_address *list) {
+  int i,j,value,count = 0;
+
+  for (i=1; i<=9; i++) {
+    for (j=1; j<=9; j++) {
+      value = session->board.section[i].cell[j];
+      if (value != 0 && session->peer_count[i][j][value] != 0) {
+        list[count].section = i;
+        list[count].cell = j;
+        list[count].value = value;
+        count++;
+      }
+    }
+  }
+  return(count);
+}
+
+void sessionSolutionFunc (SuDoku *board) {
+  memcpy(&session_found, board, sizeof(SuDoku));
+}
+
+int sessionSolvable (sudoku_session *session, long node_limit) {
+  SuDoku Board;
+  board_constraint Constraint;
+  search_state Search;
+  int i,j,value,agrees = 1,empty = 0;
+
+  for (i=1; i<=9; i++) {
+    for (j=1; j<=9; j++) {
+      value = session->board.section[i].cell[j];
+      if (value != 0 && session->peer_count[i][j][value] != 0) { return(SESSION_UNSOLVABLE); }
+      if (value == 0 && sessionCandidates(session, i, j) == 0) { return(SESSION_UNSOLVABLE); }
+      if (value == 0) { empty++; }
+      if (value != 0 && value != session->solution.section[i].cell[j]) { agrees = 0; }
+    }
+  }
+
+  if (session->have_solution != 0 && agrees != 0) {
+    return(SESSION_SOLVABLE);
+  }
+  if (empty == 0) {
+    memcpy(&session->solution, &session->board, sizeof(SuDoku));
+    session->have_solution = 1;
+    return(SESSION_SOLVABLE);
+  }
+
+  memcpy(&Board, &session->board, sizeof(SuDoku));
+  resetSearch(&Search, (node_limit != 0) ? node_limit : SESSION_NODES, 0);
+  configureSearch(&Search, BRANCH_LEAST, VALUES_ASCENDING, 0, 0);
+  resetConstraint(&Constraint);
+  updateConstraint(&Board, &Constraint);
+
+  switch (constraintPropagation(&Board, &Constraint, chooseMove(&Board, &Constraint, &Search), sessionSolutionFunc, &Search)) {
+    case SEARCH_SOLVED:
+      memcpy(&session->solution, &session_found, sizeof(SuDoku));
+      session->have_solution = 1;
+      return(SESSION_SOLVABLE);
+
+    case SEARCH_ABORTED:
+      return(SESSION_UNKNOWN);
+  }
+  return(SESSION_UNSOLVABLE);
+}
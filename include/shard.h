@@ -0,0 +1,404 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Sharded benchmark runs.  The benchmark file is cut into byte ranges,
+ * each starting on a record, and every range is solved by one worker
+ * process that writes a result record per puzzle back through its own
+ * pipe.  A crash only costs the worker of one shard, and no process is
+ * forked per puzzle.
+ *
+ * A worker that dies before finishing is started again after the last
+ * puzzle it reported.  A puzzle two workers died on is reported as
+ * crashed and skipped.  Results reach the handler in input order: those
+ * of a shard are held until every shard before it has finished.
+ *
+ * Workers triage each puzzle first (see include/triage.h) and only set
+ * up a search for the ones propagation leaves open.
+ *
+ * runShards
+ * ---------
+ * Solve every puzzle of a benchmark file on shards worker processes,
+ * each with the limits of search, or racing members searches of every
+ * puzzle if members is more than one.  Each result is passed to the
+ * handler in input order, and the totals are added up in stats.
+ *
+ */
+
+#define SHARD_CRASHED	3	/* status of a puzzle its workers kept dying on */
+#define SHARD_TRIES	2
+
+/* What a worker reports for each puzzle */
+typedef struct shard_result {
+	int status;
+	long nodes;
+	long dead_ends;
+	long msec;
+	int propagated;		/* solved by triage, without a search */
+	int strategy;		/* of the puzzle before triage, with -A */
+	long next;		/* file offset of the puzzle after this one */
+	SuDoku board;
+} shard_result;
+
+/* Pipe writes of up to PIPE_BUF bytes are never split, so workers and runShards always read whole results */
+_Static_assert(sizeof(shard_result) <= PIPE_BUF, "shard_result must fit in one atomic pipe write");
+
+typedef struct shard_stats {
+	long puzzles;
+	long solved;
+	long unsolvable;
+	long aborted;
+	long crashed;
+	long restarts;
+	long propagated;
+	long nodes;
+	long dead_ends;
+} shard_stats;
+
+/* One byte range of the file and its worker */
+typedef struct shard {
+	int index;
+	long first;		/* where the shard's byte range starts */
+	long start;		/* offset of the first puzzle not yet reported */
+	long end;
+	long failed_at;		/* where the last worker died, and how often */
+	int tries;
+	pid_t pid;
+	int fd;
+	int done;
+	shard_result *held;	/* results waiting for the shards before this one */
+	int held_count;
+	int held_size;
+} shard;
+
+typedef void (*shard_handler)(shard_result*);
+
+SuDoku shard_solution;
+
+void runShards (char*, int, search_state*, int, shard_handler, shard_stats*);
+
+void shardSolutionFunc (SuDoku *board) {
+  memcpy(&shard_solution, board, sizeof(SuDoku));
+}
+
+int shardTriage (shard_result *result) {
+/*
+ * Solve the board of a result by propagation alone if that finishes it.
+ * Returns 1 if it needs a search, leaving the board as far as
+ * propagation got and the strategy of the board as it was given.
+ *
+ */
+
+  struct timeval start, end;
+
+  gettimeofday(&start, NULL);
+  result->strategy = boardStrategy(&result->board);
+  if (triageBoard(&result->board, &shard_solution) != 0) {
+    memcpy(&result->board, &shard_solution, sizeof(SuDoku));
+    return(1);
+  }
+  gettimeofday(&end, NULL);
+
+  memcpy(&result->board, &shard_solution, sizeof(SuDoku));
+  result->status = SEARCH_SOLVED;
+  result->nodes = 0;
+  result->dead_ends = 0;
+  result->msec = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+  result->propagated = 1;
+  return(0);
+}
+
+void shardSolve (shard_result *result, search_state *limits, int members) {
+/*
+ * Solve the board of a result, with its strategy under -A, and fill in
+ * the rest of it.
+ *
+ */
+
+  board_constraint Constraint;
+  search_state search;
+
+  resetSearch(&search, limits->node_limit, limits->time_limit);
+  configureSearch(&search, BRANCH_LEAST, VALUES_ASCENDING, 0, 0);
+  if (adaptive != 0) { applyStrategy(&search, result->strategy); }
+  if (members > 1) {
+    result->status = (solvePortfolio(&result->board, members, &search) == -1) ? SEARCH_CONTINUE : SEARCH_SOLVED;
+    if (result->status == SEARCH_CONTINUE && search.aborted != 0) { result->status = SEARCH_ABORTED; }
+  } else {
+    resetConstraint(&Constraint);
+    updateConstraint(&result->board, &Constraint);
+    result->status = constraintPropagation(&result->board, &Constraint, chooseMove(&result->board, &Constraint, &search), shardSolutionFunc, &search);
+    if (result->status == SEARCH_SOLVED) {
+      memcpy(&result->board, &shard_solution, sizeof(SuDoku));
+    }
+  }
+
+  result->nodes = search.nodes;
+  result->dead_ends = search.dead_ends;
+  result->msec = searchElapsed(&search);
+  result->propagated = 0;
+}
+
+void shardWorker (int index, char *fname, long start, long end, int fd, search_state *limits, int members) {
+/*
+ * Solve the puzzles starting in start to end and exit.
+ *
+ */
+
+  shard_result result;
+  FILE *fin;
+
+  fin = fopen(fname, "rb");
+  if (fin == NULL || fseek(fin, start, SEEK_SET) != 0) {
+    exit(1);
+  }
+
+  while (ftell(fin) < end && loadBenchmark(&result.board, fin) == 0) {
+    telemetryBegin(index);
+    if (shardTriage(&result) != 0) {
+      shardSolve(&result, limits, members);
+    }
+    result.next = ftell(fin);
+    telemetryEnd(index);
+    telemetryResult(index, result.status);
+    if (write(fd, &result, sizeof(result)) != sizeof(result)) {
+      exit(1);
+    }
+  }
+
+  exit(0);
+}
+
+void shardStart (shard *s, char *fname, search_state *limits, int members) {
+  int fd[2];
+
+  if (pipe(fd) != 0) {
+    printf("Error: could not create shard pipe\n");
+    exit(1);
+  }
+
+  fflush(stdout);
+  s->pid = fork();
+  if (s->pid == 0) {
+    close(fd[0]);
+    shardWorker(s->index, fname, s->start, s->end, fd[1], limits, members);
+  }
+  if (s->pid == -1) {
+    printf("Error: could not start shard worker\n");
+    exit(1);
+  }
+
+ /* Only the worker may hold the write end, so its exit closes the pipe */
+  close(fd[1]);
+  s->fd = fd[0];
+}
+
+long *shardRecords (FILE *fin, int *count) {
+/*
+ * The offset of every puzzle in the file, read the way the workers will
+ * read them, so a shard never starts inside a multi-line board.
+ *
+ */
+
+  SuDoku board;
+  long *offsets = NULL, offset;
+  int size = 0;
+
+  *count = 0;
+  fseek(fin, 0, SEEK_SET);
+  offset = 0;
+  while (loadBenchmark(&board, fin) == 0) {
+    if (*count == size) {
+      size = size * 2 + 256;
+      offsets = realloc(offsets, size * sizeof(long));
+    }
+    offsets[(*count)++] = offset;
+    offset = ftell(fin);
+  }
+  return(offsets);
+}
+
+long shardBoundary (long *offsets, int records, long offset, long size) {
+/*
+ * The first puzzle starting at or after offset, size if there is none.
+ *
+ */
+
+  int i;
+
+  for (i=0; i<records; i++) {
+    if (offsets[i] >= offset) { return(offsets[i]); }
+  }
+  return(size);
+}
+
+void shardQueued (shard *shards, int count, shard_stats *stats) {
+/*
+ * Tell the telemetry how many puzzles are left, from the bytes left and
+ * the bytes per puzzle so far.
+ *
+ */
+
+  long left = 0, used = 0;
+  int i;
+
+  for (i=0; i<count; i++) {
+    if (shards[i].done != 0) { continue; }
+    left += shards[i].end - shards[i].start;
+  }
+  for (i=0; i<count; i++) {
+    used += shards[i].start - shards[i].first;
+  }
+  telemetryQueued((stats->puzzles != 0 && used > 0) ? left * stats->puzzles / used : 0);
+}
+
+void shardCount (shard_stats *stats, shard_result *result) {
+  stats->puzzles++;
+  stats->propagated += result->propagated;
+  stats->nodes += result->nodes;
+  stats->dead_ends += result->dead_ends;
+  switch (result->status) {
+    case SEARCH_SOLVED:   stats->solved++; break;
+    case SEARCH_ABORTED:  stats->aborted++; break;
+    case SHARD_CRASHED:   stats->crashed++; break;
+    default:              stats->unsolvable++; break;
+  }
+}
+
+void shardDeliver (shard *shards, int n, int current, shard_result *result, shard_handler handler, shard_stats *stats) {
+  shard *s = &shards[n];
+
+  shardCount(stats, result);
+  if (n == current) {
+    handler(result);
+    return;
+  }
+  if (s->held_count == s->held_size) {
+    s->held_size = s->held_size * 2 + 64;
+    s->held = realloc(s->held, s->held_size * sizeof(shard_result));
+  }
+  memcpy(&s->held[s->held_count++], result, sizeof(shard_result));
+}
+
+void shardFinished (shard *s, FILE *fin, int n, int current, char *fname, search_state *limits, int members, shard *shards, shard_handler handler, shard_stats *stats) {
+/*
+ * The pipe of a worker closed.  Unless it exited cleanly, start the shard
+ * again after its last result, or past the puzzle it keeps dying on.
+ *
+ */
+
+  shard_result crashed;
+  int status;
+
+  close(s->fd);
+  waitpid(s->pid, &status, 0);
+  if ((WIFEXITED(status) && WEXITSTATUS(status) == 0) || s->start >= s->end) {
+    s->done = 1;
+    return;
+  }
+
+  stats->restarts++;
+  s->tries = (s->failed_at == s->start) ? s->tries + 1 : 1;
+  s->failed_at = s->start;
+
+  if (s->tries >= SHARD_TRIES) {
+    memset(&crashed, 0, sizeof(crashed));
+    fseek(fin, s->start, SEEK_SET);
+    loadBenchmark(&crashed.board, fin);
+    crashed.status = SHARD_CRASHED;
+    crashed.next = ftell(fin);
+    s->start = crashed.next;
+    shardDeliver(shards, n, current, &crashed, handler, stats);
+    if (s->start >= s->end) {
+      s->done = 1;
+      return;
+    }
+  }
+
+  shardStart(s, fname, limits, members);
+}
+
+void runShards (char *fname, int count, search_state *limits, int members, shard_handler handler, shard_stats *stats) {
+  shard *shards;
+  shard_result result;
+  struct pollfd *polls;
+  FILE *fin;
+  long size, *offsets;
+  int i, j, polled, records, current = 0;
+
+  fin = fopen(fname, "rb");
+  if (fin == NULL) {
+    printf("Error: could not open '%s'\n", fname);
+    exit(1);
+  }
+  fseek(fin, 0, SEEK_END);
+  size = ftell(fin);
+  offsets = shardRecords(fin, &records);
+
+  memset(stats, 0, sizeof(shard_stats));
+  shards = calloc(count, sizeof(shard));
+  polls = malloc(count * sizeof(struct pollfd));
+  for (i=0; i<count; i++) {
+    shards[i].index = i;
+    shards[i].start = shardBoundary(offsets, records, size / count * i, size);
+    shards[i].first = shards[i].start;
+    shards[i].failed_at = -1;
+  }
+  for (i=0; i<count; i++) {
+    shards[i].end = (i < count - 1) ? shards[i+1].start : size;
+    if (shards[i].start >= shards[i].end) {
+      shards[i].done = 1;
+      continue;
+    }
+    shardStart(&shards[i], fname, limits, members);
+  }
+
+  while (current < count) {
+
+   /* Pass on the held results of every shard whose turn has come */
+    while (current < count && shards[current].done != 0) {
+      current++;
+      if (current < count) {
+        for (j=0; j<shards[current].held_count; j++) {
+          handler(&shards[current].held[j]);
+        }
+        shards[current].held_count = 0;
+      }
+    }
+    if (current == count) { break; }
+    shardQueued(shards, count, stats);
+
+    polled = 0;
+    for (i=0; i<count; i++) {
+      if (shards[i].done != 0) { continue; }
+      polls[polled].fd = shards[i].fd;
+      polls[polled].events = POLLIN;
+      polled++;
+    }
+    if (poll(polls, polled, -1) < 0) {
+      if (errno == EINTR) { continue; }
+      printf("Error: could not poll the shard workers\n");
+      exit(1);
+    }
+
+    polled = 0;
+    for (i=0; i<count; i++) {
+      if (shards[i].done != 0) { continue; }
+      if (polls[polled++].revents == 0) { continue; }
+
+      if (read(shards[i].fd, &result, sizeof(result)) == sizeof(result)) {
+        shards[i].start = result.next;
+        shardDeliver(shards, i, current, &result, handler, stats);
+      } else {
+        shardFinished(&shards[i], fin, i, current, fname, limits, members, shards, handler, stats);
+      }
+    }
+  }
+
+  for (i=0; i<count; i++) {
+    free(shards[i].held);
+  }
+  free(shards);
+  free(polls);
+  free(offsets);
+  fclose(fin);
+}
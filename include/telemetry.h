@@ -0,0 +1,346 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Live telemetry of benchmark runs.  Every worker, the forked child of a
+ * -b puzzle or a -W shard worker, counts into its own slot of a block of
+ * shared memory.  A slot has a single writer and the reporter only reads,
+ * so counting takes no locks and no atomic operations.  Slots are a cache
+ * line apart so workers never share one.
+ *
+ * A reporter thread in the main process adds up the slots.  Every period
+ * it prints a line to stderr with the puzzles per second since the last
+ * line, the puzzles in flight and queued, the worker utilization, latency
+ * percentiles and timeouts.  Given a socket path it also serves the same
+ * numbers as Prometheus text to every connection on that Unix socket,
+ * with an HTTP header so both curl --unix-socket and plain socket readers
+ * work.
+ *
+ * telemetryStart
+ * --------------
+ * Map the counters for workers workers and start the reporter.  A period
+ * of zero prints no lines, a NULL path opens no socket.
+ *
+ * telemetryBegin, telemetryEnd
+ * ----------------------------
+ * Mark the start and end of a puzzle in a worker's slot, recording its
+ * latency.
+ *
+ * telemetryIdle
+ * -------------
+ * Mark a worker idle again without counting a puzzle, when the puzzle it
+ * began is handed on to another process.
+ *
+ * telemetryResult
+ * ---------------
+ * Count a timeout or an unsolvable puzzle in a worker's slot, from
+ * whichever process learns of it.
+ *
+ * telemetryQueued
+ * ---------------
+ * Set the number of puzzles waiting for a worker.
+ *
+ * telemetryStop
+ * -------------
+ * Stop the reporter, print a last line and remove the socket.
+ *
+ */
+
+#define TELEMETRY_SLOTS		64
+#define LATENCY_BUCKETS		32	/* powers of two microseconds */
+
+/* What one worker has done, written only by that worker */
+typedef struct telemetry_slot {
+	volatile long done;
+	volatile long timeouts;
+	volatile long unsolvable;
+	volatile long busy_usec;
+	volatile long started_usec;	/* start of the puzzle in flight, 0 if idle */
+	volatile long latency[LATENCY_BUCKETS];
+} __attribute__((aligned(64))) telemetry_slot;
+
+typedef struct telemetry_block {
+	volatile long queued;
+	int workers;
+	long start_usec;
+	telemetry_slot slot[TELEMETRY_SLOTS];
+} telemetry_block;
+
+/* The slots added up */
+typedef struct telemetry_totals {
+	long done;
+	long timeouts;
+	long unsolvable;
+	long busy_usec;
+	long in_flight;
+	long latency[LATENCY_BUCKETS];
+} telemetry_totals;
+
+telemetry_block *telemetry = NULL;
+pthread_t telemetry_thread;
+volatile int telemetry_stopping = 0;
+long telemetry_period = 0;
+char *telemetry_path = NULL;
+
+void telemetryStart (int, long, char*);
+void telemetryBegin (int);
+void telemetryEnd (int);
+void telemetryIdle (int);
+void telemetryResult (int, int);
+void telemetryQueued (long);
+void telemetryStop (void);
+
+long telemetryNow (void) {
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+  return(now.tv_sec * 1000000L + now.tv_usec);
+}
+
+void telemetryBegin (int worker) {
+  if (telemetry == NULL) { return; }
+  telemetry->slot[worker % TELEMETRY_SLOTS].started_usec = telemetryNow();
+}
+
+void telemetryEnd (int worker) {
+  telemetry_slot *slot;
+  long usec;
+  int bucket = 0;
+
+  if (telemetry == NULL) { return; }
+  slot = &telemetry->slot[worker % TELEMETRY_SLOTS];
+  if (slot->started_usec == 0) { return; }
+
+  usec = telemetryNow() - slot->started_usec;
+  while (bucket < LATENCY_BUCKETS - 1 && (2L << bucket) <= usec) { bucket++; }
+
+  slot->latency[bucket]++;
+  slot->busy_usec += usec;
+  slot->done++;
+  slot->started_usec = 0;
+}
+
+void telemetryIdle (int worker) {
+  if (telemetry == NULL) { return; }
+  telemetry->slot[worker % TELEMETRY_SLOTS].started_usec = 0;
+}
+
+void telemetryResult (int worker, int status) {
+  if (telemetry == NULL) { return; }
+  if (status == SEARCH_ABORTED) { telemetry->slot[worker % TELEMETRY_SLOTS].timeouts++; }
+  if (status == SEARCH_CONTINUE) { telemetry->slot[worker % TELEMETRY_SLOTS].unsolvable++; }
+}
+
+void telemetryQueued (long queued) {
+  if (telemetry == NULL) { return; }
+  telemetry->queued = queued;
+}
+
+void telemetrySum (telemetry_totals *totals) {
+/*
+ * Add up the slots.  The busy time includes the puzzles in flight so far.
+ *
+ */
+
+  telemetry_slot *slot;
+  long now, started;
+  int i, b;
+
+  memset(totals, 0, sizeof(telemetry_totals));
+  now = telemetryNow();
+  for (i=0; i<TELEMETRY_SLOTS; i++) {
+    slot = &telemetry->slot[i];
+    started = slot->started_usec;
+    totals->done += slot->done;
+    totals->timeouts += slot->timeouts;
+    totals->unsolvable += slot->unsolvable;
+    totals->busy_usec += slot->busy_usec;
+    if (started != 0) {
+      totals->in_flight++;
+      totals->busy_usec += now - started;
+    }
+    for (b=0; b<LATENCY_BUCKETS; b++) {
+      totals->latency[b] += slot->latency[b];
+    }
+  }
+}
+
+double telemetryPercentile (telemetry_totals *totals, double fraction) {
+/*
+ * The upper bound in seconds of the latency bucket holding the fraction
+ * of the puzzles.
+ *
+ */
+
+  long seen = 0, target;
+  int b;
+
+  if (totals->done == 0) { return(0.0); }
+  target = (long)(fraction * totals->done + 0.5);
+  if (target < 1) { target = 1; }
+  for (b=0; b<LATENCY_BUCKETS - 1; b++) {
+    seen += totals->latency[b];
+    if (seen >= target) { break; }
+  }
+  return((2L << b) / 1000000.0);
+}
+
+void telemetryLine (telemetry_totals *totals, telemetry_totals *last, long usec) {
+  double seconds = (usec > 0) ? usec / 1000000.0 : 1.0;
+
+  fprintf(stderr, "telemetry: %ld done, %.1f/s, %ld in flight, %ld queued, %.0f%% busy, p50 %.3f p90 %.3f p99 %.3f sec, %ld timeouts\n",
+      totals->done, (totals->done - last->done) / seconds, totals->in_flight, telemetry->queued,
+      100.0 * (totals->busy_usec - last->busy_usec) / (seconds * 1000000.0 * telemetry->workers),
+      telemetryPercentile(totals, 0.5), telemetryPercentile(totals, 0.9), telemetryPercentile(totals, 0.99), totals->timeouts);
+}
+
+void telemetryServe (int fd) {
+/*
+ * Answer one connection with the counters as Prometheus text.
+ *
+ */
+
+  telemetry_totals totals;
+  telemetry_slot *slot;
+  struct pollfd request;
+  char buffer[65536], scratch[1024];
+  long now, elapsed;
+  int used = 0, i, b;
+  long cumulative = 0;
+
+ /* Drain an HTTP request if one comes, without waiting long for it */
+  request.fd = fd;
+  request.events = POLLIN;
+  if (poll(&request, 1, 100) > 0 && read(fd, scratch, sizeof(scratch)) < 0) {
+    return;
+  }
+
+  telemetrySum(&totals);
+  now = telemetryNow();
+  elapsed = now - telemetry->start_usec;
+
+  used += snprintf(buffer + used, sizeof(buffer) - used,
+      "# TYPE sudoku_puzzles_total counter\nsudoku_puzzles_total %ld\n"
+      "# TYPE sudoku_timeouts_total counter\nsudoku_timeouts_total %ld\n"
+      "# TYPE sudoku_unsolvable_total counter\nsudoku_unsolvable_total %ld\n"
+      "# TYPE sudoku_puzzles_per_second gauge\nsudoku_puzzles_per_second %.3f\n"
+      "# TYPE sudoku_in_flight gauge\nsudoku_in_flight %ld\n"
+      "# TYPE sudoku_queue_depth gauge\nsudoku_queue_depth %ld\n",
+      totals.done, totals.timeouts, totals.unsolvable,
+      (elapsed > 0) ? totals.done * 1000000.0 / elapsed : 0.0, totals.in_flight, telemetry->queued);
+
+  used += snprintf(buffer + used, sizeof(buffer) - used, "# TYPE sudoku_worker_utilization gauge\n");
+  for (i=0; i<telemetry->workers && i<TELEMETRY_SLOTS; i++) {
+    slot = &telemetry->slot[i];
+    used += snprintf(buffer + used, sizeof(buffer) - used, "sudoku_worker_utilization{worker=\"%d\"} %.4f\n",
+        i, (elapsed > 0) ? (double)slot->busy_usec / elapsed : 0.0);
+  }
+
+  used += snprintf(buffer + used, sizeof(buffer) - used, "# TYPE sudoku_latency_seconds histogram\n");
+  for (b=0; b<LATENCY_BUCKETS - 1; b++) {
+    cumulative += totals.latency[b];
+    used += snprintf(buffer + used, sizeof(buffer) - used, "sudoku_latency_seconds_bucket{le=\"%g\"} %ld\n", (2L << b) / 1000000.0, cumulative);
+  }
+  used += snprintf(buffer + used, sizeof(buffer) - used, "sudoku_latency_seconds_bucket{le=\"+Inf\"} %ld\n"
+      "sudoku_latency_seconds_sum %.6f\nsudoku_latency_seconds_count %ld\n",
+      totals.done, totals.busy_usec / 1000000.0, totals.done);
+
+  used += snprintf(buffer + used, sizeof(buffer) - used, "# TYPE sudoku_latency_quantile_seconds gauge\n"
+      "sudoku_latency_quantile_seconds{quantile=\"0.5\"} %g\n"
+      "sudoku_latency_quantile_seconds{quantile=\"0.9\"} %g\n"
+      "sudoku_latency_quantile_seconds{quantile=\"0.99\"} %g\n",
+      telemetryPercentile(&totals, 0.5), telemetryPercentile(&totals, 0.9), telemetryPercentile(&totals, 0.99));
+
+  snprintf(scratch, sizeof(scratch), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %d\r\n\r\n", used);
+  if (write(fd, scratch, strlen(scratch)) < 0 || write(fd, buffer, used) < 0) {
+    return;
+  }
+}
+
+void *telemetryReporter (void *threadarg) {
+  telemetry_block *block = (telemetry_block *) threadarg;
+  telemetry_totals totals, last;
+  struct sockaddr_un address;
+  struct pollfd listener;
+  long now, next_line, last_usec, wait;
+  int fd;
+
+  listener.fd = -1;
+  listener.events = POLLIN;
+  if (telemetry_path != NULL) {
+    listener.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, telemetry_path, sizeof(address.sun_path) - 1);
+    unlink(telemetry_path);
+    if (listener.fd < 0 || bind(listener.fd, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(listener.fd, 8) != 0) {
+      fprintf(stderr, "Error: could not listen on '%s'\n", telemetry_path);
+      exit(1);
+    }
+  }
+
+  memset(&last, 0, sizeof(last));
+  last_usec = block->start_usec;
+  next_line = last_usec + telemetry_period * 1000;
+  while (telemetry_stopping == 0) {
+    now = telemetryNow();
+    wait = 200;			/* look at telemetry_stopping this often */
+    if (telemetry_period != 0 && (next_line - now) / 1000 < wait) { wait = (next_line - now) / 1000; }
+    if (wait < 0) { wait = 0; }
+
+    if (poll(&listener, (listener.fd >= 0) ? 1 : 0, wait) > 0 && (listener.revents & POLLIN) != 0) {
+      fd = accept(listener.fd, NULL, NULL);
+      if (fd >= 0) {
+        telemetryServe(fd);
+        close(fd);
+      }
+    }
+
+    now = telemetryNow();
+    if (telemetry_period != 0 && now >= next_line) {
+      telemetrySum(&totals);
+      telemetryLine(&totals, &last, now - last_usec);
+      memcpy(&last, &totals, sizeof(totals));
+      last_usec = now;
+      next_line += telemetry_period * 1000;
+      if (next_line < now) { next_line = now + telemetry_period * 1000; }
+    }
+  }
+
+  if (listener.fd >= 0) {
+    close(listener.fd);
+    unlink(telemetry_path);
+  }
+  return NULL;
+}
+
+void telemetryStart (int workers, long period, char *path) {
+  telemetry = mmap(NULL, sizeof(telemetry_block), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (telemetry == MAP_FAILED) {
+    printf("Error: could not map the telemetry counters\n");
+    exit(1);
+  }
+  memset(telemetry, 0, sizeof(telemetry_block));
+  telemetry->workers = (workers < TELEMETRY_SLOTS) ? workers : TELEMETRY_SLOTS;
+  telemetry->start_usec = telemetryNow();
+
+  telemetry_period = period;
+  telemetry_path = path;
+  if (pthread_create(&telemetry_thread, NULL, telemetryReporter, telemetry) != 0) {
+    printf("Error: could not start the telemetry thread\n");
+    exit(1);
+  }
+}
+
+void telemetryStop (void) {
+  telemetry_totals totals, none;
+
+  if (telemetry == NULL) { return; }
+  telemetry_stopping = 1;
+  pthread_join(telemetry_thread, NULL);
+
+  if (telemetry_period != 0) {
+    telemetrySum(&totals);
+    memset(&none, 0, sizeof(none));
+    telemetryLine(&totals, &none, telemetryNow() - telemetry->start_usec);
+  }
+}
@@ -0,0 +1,209 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Search tracing for offline profiling.  Only built with -DSUDOKU_TRACE
+ * (make sudoku-trace), otherwise TRACE_EVENT expands to nothing and the
+ * search carries no trace code at all.
+ *
+ * Every thread records its events in its own ring buffer of TRACE_RING
+ * events, so recording takes no locks.  A full ring overwrites its oldest
+ * events.  The events are:
+ *
+ *   TRACE_BRANCH        a guess is placed, starting a subtree
+ *   TRACE_END           the subtree of the guess returned, arg is the result
+ *   TRACE_PROPAGATE     scanBoard finished, arg is the number of filled cells
+ *   TRACE_CONTRADICTION a stage proved the board dead, arg is the stage
+ *   TRACE_SOLUTION      the solution was found
+ *
+ * traceStart
+ * ----------
+ * Turn recording on.  When the process exits the rings are written to
+ * name.json, in Chrome trace event format for chrome://tracing or
+ * Perfetto, and to name.bin.  Processes forked afterwards add their pid to
+ * the names.
+ *
+ * The binary form is the header "SDKTRACE", a 32 bit version and a 32 bit
+ * ring count, then for each ring a 32 bit thread number, a 32 bit event
+ * count and that many trace_event records, oldest first.
+ *
+ */
+
+#define TRACE_BRANCH		1
+#define TRACE_END		2
+#define TRACE_PROPAGATE		3
+#define TRACE_CONTRADICTION	4
+#define TRACE_SOLUTION		5
+
+/* Stages reported by TRACE_CONTRADICTION */
+#define TRACE_STAGE_RULES	0
+#define TRACE_STAGE_TEMPLATES	1
+#define TRACE_STAGE_PROBES	2
+#define TRACE_STAGE_DEAD	3
+
+#ifdef SUDOKU_TRACE
+
+#define TRACE_RING	65536
+#define TRACE_THREADS	64
+#define TRACE_VERSION	1
+
+/* One event, 16 bytes */
+typedef struct trace_event {
+	unsigned long long nsec;	/* since traceStart */
+	unsigned char type;
+	unsigned char section;
+	unsigned char cell;
+	unsigned char value;
+	unsigned int arg;		/* search depth for TRACE_BRANCH */
+} trace_event;
+
+typedef struct trace_ring {
+	int thread;
+	unsigned long long count;	/* events ever recorded */
+	trace_event events[TRACE_RING];
+} trace_ring;
+
+int trace_enabled = 0;
+char *trace_name = NULL;
+pid_t trace_pid = 0;
+struct timespec trace_start;
+
+trace_ring *trace_rings[TRACE_THREADS];
+int trace_ring_count = 0;
+
+__thread trace_ring *trace_local = NULL;
+__thread unsigned int trace_depth = 0;
+
+#define TRACE_EVENT(type, section, cell, value, arg) \
+  do { if (trace_enabled != 0) { traceEvent((type), (section), (cell), (value), (arg)); } } while (0)
+
+void traceExport (void);
+
+void traceStart (char *name) {
+  trace_name = name;
+  trace_pid = getpid();
+  clock_gettime(CLOCK_MONOTONIC, &trace_start);
+  trace_enabled = 1;
+  atexit(traceExport);
+}
+
+void traceEvent (int type, int section, int cell, int value, unsigned int arg) {
+  struct timespec now;
+  trace_event *event;
+  int thread;
+
+  if (trace_local == NULL) {
+    thread = __sync_fetch_and_add(&trace_ring_count, 1);
+    if (thread >= TRACE_THREADS) { return; }
+    trace_local = malloc(sizeof(trace_ring));
+    trace_local->thread = thread;
+    trace_local->count = 0;
+    trace_rings[thread] = trace_local;
+  }
+
+  if (type == TRACE_BRANCH) { arg = trace_depth++; }
+  if (type == TRACE_END) { trace_depth--; }
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  event = &trace_local->events[ trace_local->count % TRACE_RING ];
+  event->nsec = (now.tv_sec - trace_start.tv_sec) * 1000000000ULL + now.tv_nsec - trace_start.tv_nsec;
+  event->type = type;
+  event->section = section;
+  event->cell = cell;
+  event->value = value;
+  event->arg = arg;
+  trace_local->count++;
+}
+
+unsigned int traceFilled (SuDoku *board) {
+  int i,j;
+  unsigned int filled = 0;
+
+  for (i=1; i<=9; i++) {
+    for (j=1; j<=9; j++) {
+      if (board->section[i].cell[j] != 0) { filled++; }
+    }
+  }
+  return(filled);
+}
+
+void traceExport (void) {
+  char *results[] = { "backtrack", "solved", "aborted" };
+  char *stages[] = { "rules", "templates", "probes", "dead table" };
+  char fname[1024], suffix[32];
+  trace_ring *ring;
+  trace_event *e;
+  unsigned long long first, n;
+  unsigned int header[2], count;
+  int rings, i, row, col, pid;
+  FILE *json, *bin;
+
+  trace_enabled = 0;
+  pid = getpid();
+  suffix[0] = '\0';
+  if (pid != trace_pid) {
+    snprintf(suffix, sizeof(suffix), ".%d", pid);
+  }
+
+  snprintf(fname, sizeof(fname), "%s%s.json", trace_name, suffix);
+  json = fopen(fname, "w");
+  snprintf(fname, sizeof(fname), "%s%s.bin", trace_name, suffix);
+  bin = fopen(fname, "wb");
+  if (json == NULL || bin == NULL) {
+    fprintf(stderr, "Error: could not write trace '%s'\n", fname);
+    return;
+  }
+
+  rings = (trace_ring_count < TRACE_THREADS) ? trace_ring_count : TRACE_THREADS;
+  fwrite("SDKTRACE", 1, 8, bin);
+  header[0] = TRACE_VERSION;
+  header[1] = rings;
+  fwrite(header, sizeof(unsigned int), 2, bin);
+
+  fprintf(json, "{\"traceEvents\":[\n");
+  fprintf(json, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"sudoku\"}}", pid);
+  for (i=0; i<rings; i++) {
+    ring = trace_rings[i];
+    first = (ring->count > TRACE_RING) ? ring->count - TRACE_RING : 0;
+    count = ring->count - first;
+
+    header[0] = ring->thread;
+    header[1] = count;
+    fwrite(header, sizeof(unsigned int), 2, bin);
+
+    for (n=first; n<ring->count; n++) {
+      e = &ring->events[n % TRACE_RING];
+      fwrite(e, sizeof(trace_event), 1, bin);
+
+      row = (e->section > 0) ? ((e->section-1)/3)*3 + (e->cell-1)/3 + 1 : 0;
+      col = (e->section > 0) ? ((e->section-1)%3)*3 + (e->cell-1)%3 + 1 : 0;
+      fprintf(json, ",\n{\"pid\":%d,\"tid\":%d,\"ts\":%.3f,", pid, ring->thread, e->nsec / 1000.0);
+      switch (e->type) {
+        case TRACE_BRANCH:
+          fprintf(json, "\"ph\":\"B\",\"name\":\"r%dc%d=%d\",\"args\":{\"depth\":%u}}", row, col, e->value, e->arg);
+          break;
+        case TRACE_END:
+          fprintf(json, "\"ph\":\"E\",\"args\":{\"result\":\"%s\"}}", results[e->arg % 3]);
+          break;
+        case TRACE_PROPAGATE:
+          fprintf(json, "\"ph\":\"i\",\"s\":\"t\",\"name\":\"propagate\",\"args\":{\"filled\":%u}}", e->arg);
+          break;
+        case TRACE_CONTRADICTION:
+          fprintf(json, "\"ph\":\"i\",\"s\":\"t\",\"name\":\"contradiction\",\"args\":{\"stage\":\"%s\"}}", stages[e->arg % 4]);
+          break;
+        default:
+          fprintf(json, "\"ph\":\"i\",\"s\":\"p\",\"name\":\"solution\"}");
+          break;
+      }
+    }
+  }
+  fprintf(json, "\n]}\n");
+
+  fclose(json);
+  fclose(bin);
+}
+
+#else
+
+#define TRACE_EVENT(type, section, cell, value, arg)
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Transposition table of boards the search has proven to have no solution.
+ *
+ * A board is identified by its Zobrist hash (see boardHash in sudoku.h),
+ * which placeValue keeps up to date as cells are filled.  Whether a board
+ * can be completed depends only on its filled cells, not on the path the
+ * search took to reach it, so a board proven dead once can be pruned the
+ * next time any branch, thread or puzzle reaches it.
+ *
+ * The table is a fixed number of 64 bit slots in buckets of four.  Each
+ * slot holds one hash and is read and written with single atomic stores,
+ * so threads share the table without locks.  It is mapped shared, so the
+ * processes forked for -b and -P share it as well.
+ *
+ * createDeadTable
+ * ---------------
+ * Allocate a table of 2^bits slots and generate the Zobrist keys.
+ *
+ * clearDeadTable
+ * --------------
+ * Forget every recorded board.
+ *
+ * deadState
+ * ---------
+ * Returns 1 if the hash is recorded as dead, 0 if not or if there is
+ * no table.
+ *
+ * recordDead
+ * ----------
+ * Record a hash as dead, replacing an older entry if the bucket is full.
+ *
+ */
+
+#define DEAD_BUCKET 4
+
+unsigned long long *dead_table = NULL;
+unsigned long long dead_mask = 0;
+
+void createDeadTable (int bits) {
+  size_t size;
+
+  if (bits < 2 || bits > 34) {
+    printf("Error: table size must be between 2 and 34 bits\n");
+    exit(1);
+  }
+
+  size = (size_t)1 << bits;
+  dead_table = mmap(NULL, size * sizeof(unsigned long long), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (dead_table == MAP_FAILED) {
+    printf("Error: could not allocate a table of %lu entries\n", (unsigned long)size);
+    exit(1);
+  }
+  dead_mask = (size - 1) & ~(unsigned long long)(DEAD_BUCKET - 1);
+
+  loadZobrist();
+}
+
+void clearDeadTable (void) {
+  if (dead_table == NULL) { return; }
+  memset(dead_table, 0, (dead_mask + DEAD_BUCKET) * sizeof(unsigned long long));
+}
+
+int deadState (unsigned long long hash) {
+  unsigned long long *bucket;
+  int i;
+
+  if (dead_table == NULL || hash == 0) { return(0); }
+
+  bucket = &dead_table[hash & dead_mask];
+  for (i=0; i<DEAD_BUCKET; i++) {
+    if (__atomic_load_n(&bucket[i], __ATOMIC_RELAXED) == hash) { return(1); }
+  }
+  return(0);
+}
+
+void recordDead (unsigned long long hash) {
+  unsigned long long *bucket, entry;
+  int i;
+
+  if (dead_table == NULL || hash == 0) { return; }
+
+  bucket = &dead_table[hash & dead_mask];
+  for (i=0; i<DEAD_BUCKET; i++) {
+    entry = __atomic_load_n(&bucket[i], __ATOMIC_RELAXED);
+    if (entry == hash) { return; }
+    if (entry == 0) {
+      __atomic_store_n(&bucket[i], hash, __ATOMIC_RELAXED);
+      return;
+    }
+  }
+
+ /* Bucket full, replace a slot picked by the high bits of the hash */
+  __atomic_store_n(&bucket[hash >> 62], hash, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,33 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Triage of batch puzzles.  Most puzzles are finished by scanBoard
+ * alone, so batch runs first propagate each puzzle in the running
+ * process, with the constraint on the stack, and only hand the ones it
+ * leaves open to the search: a forked child per puzzle with -b, the
+ * worker processes with -W.  Propagation only places forced values, so a
+ * board it finishes is the one the search would return, and the search
+ * of the rest starts where it stalled instead of doing it over.
+ *
+ * triageBoard
+ * -----------
+ * Propagate a copy of the board into solved.  Returns 0 if that solves
+ * it, 1 if it needs a search, which can start from solved as far as it
+ * got.  A board propagation proves broken needs one too, so the search
+ * reports it as usual.
+ *
+ */
+
+int triageBoard (SuDoku*, SuDoku*);
+
+int triageBoard (SuDoku *board, SuDoku *solved) {
+  board_constraint Constraint;
+
+  memcpy(solved, board, sizeof(SuDoku));
+  resetConstraint(&Constraint);
+  if (scanBoard(solved, &Constraint) != 0) {
+    return(1);
+  }
+
+  return(checkRules(solved) != 0);
+}
@@ -0,0 +1,239 @@
+/*
+ * Program: SuDoku Killer
+ *
+ * Bulk verification of completed boards produced elsewhere.
+ *
+ * Each line of the input holds either a solution alone (81 cells) or a
+ * puzzle followed by its solution (162 cells), in the same characters
+ * loadBenchmark accepts.  Anything else on the line is ignored.
+ *
+ * verifyFile
+ * ----------
+ * Load the whole file, split it into one chunk per processor and check
+ * every line.  Only failures are printed, in input order.  Returns the
+ * number of lines that failed.
+ *
+ * verifyGrid
+ * ----------
+ * Check one solution, and optionally its puzzle, using one bit per number.
+ * Every row, column and section is reduced by OR-ing nine vectors of nine
+ * lanes and comparing each lane against all nine bits.  Returns one of the
+ * VERIFY_ codes below.
+ *
+ */
+
+#define VERIFY_OK		0
+#define VERIFY_MALFORMED	1
+#define VERIFY_INCOMPLETE	2
+#define VERIFY_DUPLICATE	3
+#define VERIFY_CLUE		4
+
+char *verify_reasons[] = { "ok", "malformed line", "incomplete solution", "rule broken", "solution does not match clue" };
+
+/* Sixteen lanes, one per row, column or section, of nine bit masks */
+typedef unsigned short unit_vec __attribute__ ((vector_size (32)));
+
+/* One failed line, numbered from the start of its chunk */
+typedef struct verify_failure {
+	long line;
+	int reason;
+} verify_failure;
+
+/* Work for one verification thread */
+typedef struct verify_chunk {
+	char *start;
+	char *end;
+	long lines;
+	long grids;
+	long failure_count;
+	long failure_size;
+	verify_failure *failures;
+} verify_chunk;
+
+int verifyGrid (unsigned short*, unsigned short*);
+void *verifyChunk (void*);
+long verifyFile (char*);
+
+int verifyGrid (unsigned short *puzzle, unsigned short *solution) {
+  unit_vec by_row[9], by_col[9], by_box[9];
+  unit_vec rows, cols, boxes, full, empty = { 0 };
+  unsigned short clues = 0;
+  int i, row, col, box;
+
+  for (i=0; i<16; i++) {
+    full[i] = (i < 9) ? 0x1FF : 0;
+  }
+  for (i=0; i<9; i++) {
+    by_row[i] = empty;
+    by_col[i] = empty;
+    by_box[i] = empty;
+  }
+
+ /* Scatter each cell into the lane of its row, column and section */
+  for (i=0; i<81; i++) {
+    row = i / 9;
+    col = i % 9;
+    box = (row/3)*3 + col/3;
+
+    by_row[col][row] = solution[i];
+    by_col[row][col] = solution[i];
+    by_box[(row%3)*3 + col%3][box] = solution[i];
+
+    if (puzzle != NULL) {
+      clues |= puzzle[i] & ~solution[i];
+    }
+  }
+
+  rows = by_row[0];
+  cols = by_col[0];
+  boxes = by_box[0];
+  for (i=1; i<9; i++) {
+    rows |= by_row[i];
+    cols |= by_col[i];
+    boxes |= by_box[i];
+  }
+
+  for (i=0; i<81; i++) {
+    if (solution[i] == 0) { return(VERIFY_INCOMPLETE); }
+  }
+
+ /* Nine single bit cells cover all nine bits only if no number repeats */
+  rows = (rows ^ full) | (cols ^ full) | (boxes ^ full);
+  for (i=0; i<9; i++) {
+    if (rows[i] != 0) { return(VERIFY_DUPLICATE); }
+  }
+
+  if (clues != 0) { return(VERIFY_CLUE); }
+
+  return(VERIFY_OK);
+}
+
+void *verifyChunk (void *threadarg) {
+  verify_chunk *chunk;
+  unsigned short cells[162];
+  char *p;
+  int count, reason;
+
+  chunk = (verify_chunk *) threadarg;
+  chunk->lines = 0;
+  chunk->grids = 0;
+  chunk->failure_count = 0;
+  chunk->failure_size = 0;
+  chunk->failures = NULL;
+
+  p = chunk->start;
+  while (p < chunk->end) {
+    count = 0;
+    while (p < chunk->end && *p != '\n') {
+      if (*p >= '1' && *p <= '9') {
+        if (count < 162) { cells[count] = 1 << (*p - '1'); }
+        count++;
+      } else if (*p == '0' || *p == '.' || *p == '_') {
+        if (count < 162) { cells[count] = 0; }
+        count++;
+      }
+      p++;
+    }
+    p++;
+    chunk->lines++;
+
+    if (count == 0) { continue; }
+
+    chunk->grids++;
+    if (count == 81) {
+      reason = verifyGrid(NULL, &cells[0]);
+    } else if (count == 162) {
+      reason = verifyGrid(&cells[0], &cells[81]);
+    } else {
+      reason = VERIFY_MALFORMED;
+    }
+
+    if (reason != VERIFY_OK) {
+      if (chunk->failure_count == chunk->failure_size) {
+        chunk->failure_size = chunk->failure_size * 2 + 64;
+        chunk->failures = realloc(chunk->failures, chunk->failure_size * sizeof(verify_failure));
+      }
+      chunk->failures[chunk->failure_count].line = chunk->lines;
+      chunk->failures[chunk->failure_count].reason = reason;
+      chunk->failure_count++;
+    }
+  }
+
+  return NULL;
+}
+
+long verifyFile (char *fname) {
+  FILE *fin;
+  char *buffer, *p;
+  long size, used, failed, grids, line;
+  int i, j, threads, rc;
+  pthread_t *thread;
+  verify_chunk *chunks;
+
+  if ( strncmp("-", fname, 1) == 0) {
+    fin = fdopen(dup(STDIN_FILENO), "r");
+  } else {
+    fin = fopen(fname, "rb");
+  }
+  if ( fin == NULL ) {
+    printf ("Error: could not open '%s'\n", fname);
+    exit(1);
+  }
+
+  size = 1 << 20;
+  used = 0;
+  buffer = malloc(size);
+  while ((rc = fread(buffer + used, 1, size - used, fin)) > 0) {
+    used += rc;
+    if (used == size) {
+      size *= 2;
+      buffer = realloc(buffer, size);
+    }
+  }
+  fclose(fin);
+
+  threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (threads < 1) { threads = 1; }
+  thread = malloc(threads * sizeof(pthread_t));
+  chunks = malloc(threads * sizeof(verify_chunk));
+
+ /* Split on line boundaries, one chunk per processor */
+  p = buffer;
+  for (i=0; i<threads; i++) {
+    chunks[i].start = p;
+    if (i == threads - 1) {
+      p = buffer + used;
+    } else {
+      p = buffer + used * (i+1) / threads;
+      if (p < chunks[i].start) { p = chunks[i].start; }
+      while (p < buffer + used && *p != '\n') { p++; }
+      if (p < buffer + used) { p++; }
+    }
+    chunks[i].end = p;
+
+    rc = pthread_create(&thread[i], NULL, verifyChunk, &chunks[i]);
+    if (rc) { printf("Error: return code from pthread_create() is %d\n",rc); exit(-1); }
+  }
+
+  failed = 0;
+  grids = 0;
+  line = 0;
+  for (i=0; i<threads; i++) {
+    pthread_join(thread[i], NULL);
+
+    for (j=0; j<chunks[i].failure_count; j++) {
+      printf("line %ld: %s\n", line + chunks[i].failures[j].line, verify_reasons[ chunks[i].failures[j].reason ]);
+    }
+    line += chunks[i].lines;
+    grids += chunks[i].grids;
+    failed += chunks[i].failure_count;
+    free(chunks[i].failures);
+  }
+
+  fprintf(stderr, "Verified %ld boards, %ld failed\n", grids, failed);
+
+  free(chunks);
+  free(thread);
+  free(buffer);
+  return(failed);
+}
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "sudoku.h"
+#include "include/killer.h"
+#include "include/easy_solve.h"
+#include "include/medium_solve.h"
+#include "include/transposition.h"
+#include "include/trace.h"
+#include "include/hard_solve.h"
+
+/*
+ * Program: SuDoku Killer
+ *
+ * Microbenchmarks for the individual solver functions.
+ *
+ * The board and constraint states are captured by following the search
+ * down from each puzzle of a corpus: guess at findLeastConstrained's cell,
+ * scanBoard, updateConstraint, and keep every state along the way until
+ * the board is solved or broken.  Each function is then timed over the
+ * whole set of states, so the numbers are stable from run to run and
+ * reflect boards the solver really sees.
+ *
+ */
+
+#define MAX_STATES 4096
+
+/* One captured search state */
+typedef struct search_snapshot {
+	SuDoku board;
+	board_constraint constraint;
+	c_address move;
+} search_snapshot;
+
+search_snapshot *states;
+int state_count = 0;
+
+/* Text of the corpus, for loadBenchmark */
+char *corpus_text;
+long corpus_size;
+
+/* Keeps results alive */
+volatile long sink;
+
+long target_nsec = 200000000;
+
+/******************************************************************************/
+void printUsage( ) {
+  printf ("\nUsage: sudoku-micro [-h] [-f file] [-t msec]\n");
+  printf ("	-h	Print this help message\n");
+  printf ("	-f file	Capture states from this corpus, default boards/Top95.txt\n");
+  printf ("	-t msec	Time spent on each function, default 200\n");
+  printf ("\n");
+}
+/******************************************************************************/
+
+/******************************************************************************/
+long nowNsec( void ) {
+/******************************************************************************/
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return(now.tv_sec * 1000000000L + now.tv_nsec);
+}
+
+/******************************************************************************/
+void captureStates(char *fname) {
+/******************************************************************************/
+  FILE *fin;
+  SuDoku Board;
+  board_constraint Constraint;
+  c_address move;
+  long used;
+
+  fin = fopen(fname, "rb");
+  if ( fin == NULL ) {
+    printf("Error: could not open '%s'\n", fname);
+    exit(1);
+  }
+
+  corpus_size = 1 << 16;
+  corpus_text = malloc(corpus_size);
+  used = 0;
+  while ((used += fread(corpus_text + used, 1, corpus_size - used, fin)) == corpus_size) {
+    corpus_size *= 2;
+    corpus_text = realloc(corpus_text, corpus_size);
+  }
+  corpus_size = used;
+  rewind(fin);
+
+  states = malloc(MAX_STATES * sizeof(search_snapshot));
+  while (state_count < MAX_STATES && loadBenchmark(&Board, fin) == 0) {
+    resetConstraint(&Constraint);
+    updateConstraint(&Board, &Constraint);
+
+    while (state_count < MAX_STATES && checkConstraintRules(&Board, &Constraint) == 0) {
+      move = findLeastConstrained(&Board, &Constraint);
+      if (move.section == 0 || move.value == 0) { break; }
+
+      memcpy(&states[state_count].board, &Board, sizeof(SuDoku));
+      memcpy(&states[state_count].constraint, &Constraint, sizeof(board_constraint));
+      states[state_count].move = move;
+      state_count++;
+
+      placeValue(&Board, move.section, move.cell, move.value);
+      if (scanBoard(&Board, &Constraint) == 0) { break; }
+      updateConstraint(&Board, &Constraint);
+    }
+  }
+  fclose(fin);
+
+  if (state_count == 0) {
+    printf("Error: no search states in '%s'\n", fname);
+    exit(1);
+  }
+}
+
+/******************************************************************************/
+long runKernel(int kernel, long ops) {
+/******************************************************************************/
+/*
+ * Run one function ops times, cycling through the captured states.
+ * Functions that change the board work on a copy.  Returns nanoseconds.
+ *
+ */
+  SuDoku Board;
+  board_constraint Constraint;
+  search_snapshot *s;
+  FILE *fin = NULL;
+  long i, start;
+
+  if (kernel == 7) {
+    fin = fmemopen(corpus_text, corpus_size, "r");
+  }
+
+  start = nowNsec();
+  for (i=0; i<ops; i++) {
+    s = &states[i % state_count];
+    switch (kernel) {
+      case 0:		/* the copy every other kernel pays for */
+        memcpy(&Board, &s->board, sizeof(SuDoku));
+        memcpy(&Constraint, &s->constraint, sizeof(board_constraint));
+        break;
+
+      case 1:
+        memcpy(&Board, &s->board, sizeof(SuDoku));
+        memcpy(&Constraint, &s->constraint, sizeof(board_constraint));
+        updateConstraint(&Board, &Constraint);
+        break;
+
+      case 2:
+        memcpy(&Board, &s->board, sizeof(SuDoku));
+        memcpy(&Constraint, &s->constraint, sizeof(board_constraint));
+        placeValue(&Board, s->move.section, s->move.cell, s->move.value);
+        sink += scanBoard(&Board, &Constraint);
+        break;
+
+      case 3:
+        sink += findLeastConstrained(&s->board, &s->constraint).value;
+        break;
+
+      case 4:
+        sink += nextConstraint(&s->constraint, s->move).value;
+        break;
+
+      case 5:
+        sink += checkConstraintRules(&s->board, &s->constraint);
+        break;
+
+      case 6:
+        sink += checkRules(&s->board);
+        break;
+
+      case 7:
+        if (loadBenchmark(&Board, fin) != 0) {
+          rewind(fin);
+        }
+        break;
+    }
+  }
+
+  start = nowNsec() - start;
+  if (fin != NULL) { fclose(fin); }
+  return(start);
+}
+
+/******************************************************************************/
+int main (int argc, char *argv[]) {
+/******************************************************************************/
+  char *names[] = { "copy state", "updateConstraint", "scanBoard", "findLeastConstrained",
+                    "nextConstraint", "checkConstraintRules", "checkRules", "loadBenchmark" };
+  int copies[] = { 0, 1, 1, 0, 0, 0, 0, 0 };
+  char *filename = "boards/Top95.txt";
+  long ops, nsec;
+  double per_op, copy_nsec = 0;
+  int kernel, opt;
+
+  while ((opt = getopt(argc, argv, ":hf:t:")) != -1) {
+    switch(opt) {
+      case 'h':
+        printUsage();
+        exit(0);
+
+      case 'f':
+        filename = optarg;
+        break;
+
+      case 't':
+        target_nsec = atol(optarg) * 1000000L;
+        break;
+    }
+  }
+
+  captureStates(filename);
+  printf("%d states captured from %s\n\n", state_count, filename);
+  printf("%-22s %12s %14s\n", "function", "ns/op", "ops/s");
+
+  for (kernel=0; kernel<8; kernel++) {
+
+   /* Grow the run until it takes at least a tenth of the target time, then scale */
+    ops = 16;
+    runKernel(kernel, ops);
+    while ((nsec = runKernel(kernel, ops)) < target_nsec / 10) {
+      ops *= 4;
+    }
+    ops = ops * (double)target_nsec / nsec;
+    if (ops < 1) { ops = 1; }
+    nsec = runKernel(kernel, ops);
+
+    per_op = (double)nsec / ops;
+    if (kernel == 0) {
+      copy_nsec = per_op;
+    } else if (copies[kernel] != 0) {
+      per_op -= copy_nsec;
+    }
+
+    printf("%-22s %12.1f %14.0f\n", names[kernel], per_op, 1000000000.0 / per_op);
+  }
+
+  if (sink == 0x7fffffff) { printf("\n"); }
+  exit(0);
+}
@@ -6,27 +6,62 @@
 #include <pthread.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <unistd.h>
 #include <errno.h>
+#include <limits.h>
+#include <poll.h>
 #include <time.h>
 
 #include "sudoku.h"
+#include "include/killer.h"
 #include "include/easy_solve.h"
+#include "include/medium_solve.h"
+#include "include/transposition.h"
+#include "include/trace.h"
 #include "include/hard_solve.h"
+#include "include/verify.h"
+#include "include/adaptive.h"
+#include "include/portfolio.h"
+#include "include/lanes.h"
+#include "include/session.h"
+#include "include/enumerate.h"
+#include "include/minimal.h"
+#include "include/telemetry.h"
+#include "include/triage.h"
+#include "include/shard.h"
+#include "include/schedule.h"
+#include "include/checkpoint.h"
+#include "include/multigrid.h"
 
 struct cp_thread_data {
   int thread_id;
   SuDoku *board;
   board_constraint *constraint;
   c_address curCell;
+  search_state *search;
 };
 
 /* Master array of threads */
 struct cp_thread_data cp_thread_data_array[9];
 
 void printSummary( void );
+void printSearchFailure(search_state*);
+void solvePortfolioBoard(SuDoku*, int);
+int triageBenchmarkBoard(SuDoku*, int*);
+void solveBenchmarkBoard(SuDoku*, FILE*, int, int, int);
 void scanConstraintsPthread(SuDoku);
+void runSession(SuDoku*);
+void enumerateBoard(SuDoku*, int, int);
+void minimalBoards(SuDoku*, FILE*);
+void shardBenchmark(char*, int, int, int);
+void resumeBenchmark(FILE*, int, int*);
+void checkpointBenchmark(FILE*, int, int);
+void solveMultiGridBoard(char*, int);
 
 /* Timers for total run time */
 struct timeval real_start, real_end;
@@ -34,15 +69,47 @@ struct timeval real_start, real_end;
 /* Benchmark info */
 int benchmark = 0;
 
+/* Checkpoints of a benchmark run, see include/checkpoint.h */
+char *checkpoint_file = NULL;
+struct timeval checkpoint_last;
+
+/* Per puzzle search budget, zero for unlimited */
+long node_limit = 0;
+long time_limit = 0;
+search_state Search;
+
 /******************************************************************************/
 void printUsage( ) {
-  printf ("\nUsage: sudoku [-hbptc] [-f file]\n");
+  printf ("\nUsage: sudoku [-hbptcmvSianMGUg] [-f file] [-T msec] [-N nodes] [-P members] [-L probes] [-H bits] [-R name] [-W shards] [-O probes] [-A table] [-C table] [-K file] [-E msec] [-X socket]\n");
   printf ("	-h	Print this help message\n");
   printf ("	-f file	Use input file instead of default 'board.txt'\n");
   printf ("	-t	Use multithreading\n");
   printf ("	-b	Benchmark, input file should be Top95 format\n");
+  printf ("	-S	With -b, propagate %d puzzles at a time in lockstep before searching\n", LANES);
+  printf ("	-v	Verify solved boards, one per line, optionally after their puzzle\n");
   printf ("	-p	Print the unfinished board and exit\n");
+  printf ("	-g	Solve overlapping grids, such as a Samurai, from a grid layout file\n");
   printf ("	-c	Print the constraints of the board and exit\n");
+  printf ("	-i	Play the board interactively, reading commands from stdin\n");
+  printf ("	-a	Print every solution of the board, one per line\n");
+  printf ("	-n	Count the solutions of the board\n");
+  printf ("	-M	Report the clues the board does not need, for every puzzle with -b\n");
+  printf ("	-m	Eliminate with number templates before every guess\n");
+  printf ("	-G	Print how often each tier of propagation made progress to stderr\n");
+  printf ("	-T msec	Give up on a puzzle after msec milliseconds of searching\n");
+  printf ("	-N nodes	Give up on a puzzle after searching nodes guesses\n");
+  printf ("	-L probes	Probe up to probes candidates for contradictions before every guess\n");
+  printf ("	-H bits	Prune boards already proven dead, in a table of 2^bits entries\n");
+  printf ("	-P members	Race members differently configured searches of the puzzle\n");
+  printf ("	-R name	Trace the search to name.json and name.bin (sudoku-trace only)\n");
+  printf ("	-W shards	With -b, split the file between shards worker processes\n");
+  printf ("	-O probes	With -W, hand out the puzzles hardest first, estimated by probes random probes\n");
+  printf ("	-A table	Choose the search strategy of each puzzle from a strategy table\n");
+  printf ("	-C table	With -b, time every strategy on the puzzles and write the table\n");
+  printf ("	-K file	With -b, checkpoint the run to file every second\n");
+  printf ("	-U	With -K, resume the run from its checkpoint, appending to the output\n");
+  printf ("	-E msec	With -b, print throughput and latency to stderr every msec milliseconds\n");
+  printf ("	-X socket	With -b, serve the same numbers as Prometheus text on a Unix socket\n");
   printf ("\n");
 }
 /******************************************************************************/
@@ -79,7 +146,7 @@ void *pthread_callConstraintPropagation( void *threadarg) {
     printf(" => %d\n", my_data->curCell.value);
   }
 
-  constraintPropagation (my_data->board, my_data->constraint, my_data->curCell, solutionFunc);
+  constraintPropagation (my_data->board, my_data->constraint, my_data->curCell, solutionFunc, my_data->search);
   return NULL;
 }
 
@@ -92,9 +159,24 @@ int main (int argc, char *argv[]) {
   int print_board = 0;
   int print_constraints = 0;
   int thread = 0;
+  int verify = 0;
+  int portfolio = 0;
+  int lanes = 0;
+  int interactive = 0;
+  int enumerate = 0;
+  int minimal = 0;
+  int shards = 0;
+  int schedule_probes = 0;
+  int multigrid = 0;
+  char *calibrate = NULL;
+  int resume = 0;
+  long telemetry_msec = 0;
+  char *telemetry_socket = NULL;
+  SuDoku Lanes[LANES];
+  int status[LANES], strategy[LANES], count, more, i;
+  int propagated = 0;				/* puzzles finished without a search, in lanes or by triage */
 
   FILE *fin;
-  pid_t child_pid;
   
   extern char *optarg;				/* Operand variables */
   extern int optind, optopt, opterr;
@@ -104,7 +186,7 @@ int main (int argc, char *argv[]) {
   gettimeofday(&real_start, NULL);
 
  /* Get operands */
-  while ((opt = getopt(argc, argv, ":hbpcts:d:f:")) != -1) {
+  while ((opt = getopt(argc, argv, ":hbpctmvSianMGgs:d:f:T:N:P:L:H:R:W:O:A:C:K:UE:X:")) != -1) {
     switch(opt) {
       case 'h':
         printUsage();
@@ -114,6 +196,30 @@ int main (int argc, char *argv[]) {
         benchmark = 1;
         break;
 
+      case 'S':
+        lanes = 1;
+        break;
+
+      case 'v':
+        verify = 1;
+        break;
+
+      case 'i':
+        interactive = 1;
+        break;
+
+      case 'a':
+        enumerate = 1;
+        break;
+
+      case 'n':
+        enumerate = 2;
+        break;
+
+      case 'M':
+        minimal = 1;
+        break;
+
       case 'p':
         print_board = 1;
         break;
@@ -122,14 +228,107 @@ int main (int argc, char *argv[]) {
         print_constraints = 1;
         break;
 
+      case 'g':
+        multigrid = 1;
+        break;
+
       case 't':
         thread = 1;
         break;
 
+      case 'm':
+      case 'L':
+      case 'H':
+        searchOption(opt, optarg);
+        break;
+
+      case 'G':
+        startPropagationStats();
+        break;
+
       case 'f':
         filename = optarg;
         break;
+
+      case 'T':
+        time_limit = atol(optarg);
+        break;
+
+      case 'N':
+        node_limit = atol(optarg);
+        break;
+
+      case 'P':
+        portfolio = atoi(optarg);
+        break;
+
+      case 'W':
+        shards = atoi(optarg);
+        break;
+
+      case 'O':
+        schedule_probes = atoi(optarg);
+        break;
+
+      case 'A':
+        loadStrategyTable(optarg);
+        break;
+
+      case 'C':
+        calibrate = optarg;
+        break;
+
+      case 'K':
+        checkpoint_file = optarg;
+        break;
+
+      case 'U':
+        resume = 1;
+        break;
+
+      case 'E':
+        telemetry_msec = atol(optarg);
+        break;
+
+      case 'X':
+        telemetry_socket = optarg;
+        break;
+
+      case 'R':
+#ifdef SUDOKU_TRACE
+        traceStart(optarg);
+#else
+        printf("Error: -R needs a build with tracing, make sudoku-trace\n");
+        exit(1);
+#endif
+        break;
+    }
+  }
+
+  if (verify == 1) {
+    if (verifyFile(filename) != 0) {
+      exit(1);
     }
+    exit(0);
+  }
+
+  if (benchmark == 1 && (telemetry_msec > 0 || telemetry_socket != NULL)) {
+    telemetryStart((shards > 0) ? shards : 1, telemetry_msec, telemetry_socket);
+  }
+
+  if (schedule_probes > 0 && (benchmark == 0 || shards == 0)) {
+    printf("Error: -O needs a benchmark run on worker processes, -b -W shards\n");
+    exit(1);
+  }
+
+  if (shards > 0 && (checkpoint_file != NULL || resume == 1)) {
+    printf("Error: -K and -U checkpoint a run in one process, not -W shards\n");
+    exit(1);
+  }
+
+  if (benchmark == 1 && shards > 0) {
+    shardBenchmark(filename, shards, portfolio, schedule_probes);
+    exit(0);
   }
 
   if (benchmark == 1) {
@@ -143,26 +342,80 @@ int main (int argc, char *argv[]) {
       exit(1);
     }
 
-    printf("\n");
-    while (loadBenchmark(&Board,fin) == 0) {
-      child_pid = fork();
-      if (child_pid == 0) {
-        fclose(fin);
-        if (thread == 0) {
-          resetConstraint(&Constraint);
-          updateConstraint(&Board, &Constraint);
+    if (minimal == 1) {
+      minimalBoards(NULL, fin);
+      exit(0);
+    }
+
+    if (calibrate != NULL) {
+      resetSearch(&Search, node_limit, time_limit);
+      calibrateStrategies(fin, calibrate, &Search);
+      exit(0);
+    }
+
+    if (checkpoint_file != NULL) {
+      resumeBenchmark(fin, resume, &propagated);
+    } else if (resume == 1) {
+      printf("Error: -U needs the checkpoint file, -K file\n");
+      exit(1);
+    }
 
-          constraintPropagation (&Board, &Constraint, findLeastConstrained(&Board, &Constraint), solutionFunc);
+    if (resume == 0) { printf("\n"); }
+    if (lanes == 0) {
+      while (loadBenchmark(&Board,fin) == 0) {
+        if (triageBenchmarkBoard(&Board, &strategy[0]) == 0) {
+          propagated++;
         } else {
-          scanConstraintsPthread(Board);
+          solveBenchmarkBoard(&Board, fin, thread, portfolio, strategy[0]);
+        }
+        checkpointBenchmark(fin, propagated, 0);
+      }
+    } else {
+
+     /* Fill the lanes, propagate them together and search only the open boards */
+      count = 0;
+      more = 1;
+      while (more == 1) {
+        more = (loadBenchmark(&Lanes[count], fin) == 0);
+        if (more == 1) { count++; }
+        if (count == LANES || (more == 0 && count > 0)) {
+          for (i=0; i<count; i++) {
+            strategy[i] = boardStrategy(&Lanes[i]);
+          }
+          loadLanes(&Lanes[0], count);
+          propagateLanes(&Lanes[0], count, &status[0]);
+          for (i=0; i<count; i++) {
+            telemetryQueued(count - i - 1);
+            if (status[i] == LANE_OPEN) {
+              solveBenchmarkBoard(&Lanes[i], fin, thread, portfolio, strategy[i]);
+              continue;
+            }
+            resetSearch(&Search, node_limit, time_limit);
+            telemetryBegin(0);
+            if (status[i] == LANE_SOLVED) {
+              printBoardBenchmark(&Lanes[i]);
+              propagated++;
+            } else {
+              printSearchFailure(&Search);
+            }
+            telemetryEnd(0);
+            benchmark++;
+          }
+          count = 0;
+          checkpointBenchmark(fin, propagated, 0);
         }
-        exit(0);
-      } else {
-        waitpid(child_pid, NULL, 0);
-        benchmark++;
       }
     }
 
+   /* A finished run resumes straight to its summary */
+    checkpointBenchmark(fin, propagated, 1);
+    telemetryStop();
+    if (lanes != 0) {
+      printf("\n%d of %d puzzles finished in lanes\n", propagated, benchmark - 1);
+    } else {
+      printf("\n%d puzzles: %d solved by propagation, %d searched\n", benchmark - 1, propagated, benchmark - 1 - propagated);
+    }
+
     benchmark = 0;
     gettimeofday(&real_end, NULL);
 
@@ -170,9 +423,29 @@ int main (int argc, char *argv[]) {
     exit(0);
   }
 
+  if (multigrid == 1) {
+    solveMultiGridBoard(filename, print_board);
+    exit(0);
+  }
+
   resetBoard(&Board);
   loadBoard(&Board, filename);
 
+  if (interactive == 1) {
+    runSession(&Board);
+    exit(0);
+  }
+
+  if (enumerate != 0) {
+    enumerateBoard(&Board, enumerate == 2, thread);
+    exit(0);
+  }
+
+  if (minimal == 1) {
+    minimalBoards(&Board, NULL);
+    exit(0);
+  }
+
   resetConstraint(&Constraint);
   updateConstraint(&Board, &Constraint);
 
@@ -183,8 +456,13 @@ int main (int argc, char *argv[]) {
     exit(0);
   }
 
-  if (thread == 0) {
-    constraintPropagation (&Board, &Constraint, findLeastConstrained(&Board, &Constraint), solutionFunc);
+  resetSearch(&Search, node_limit, time_limit);
+  if (adaptive != 0) { adaptSearch(&Board, &Search); }
+  if (portfolio > 1) {
+    solvePortfolioBoard(&Board, portfolio);
+  } else if (thread == 0) {
+    constraintPropagation (&Board, &Constraint, chooseMove(&Board, &Constraint, &Search), solutionFunc, &Search);
+    printSearchFailure(&Search);
   } else {
     scanConstraintsPthread(Board);
   }
@@ -234,7 +512,7 @@ void scanConstraintsPthread(SuDoku Board) {
       newConstraint = malloc(sizeof(board_constraint));
       memcpy(newConstraint, &Constraint, sizeof(board_constraint));
 
-      newBoard->section[ listMove[j].section ].cell[ listMove[j].cell ] = listMove[j].value;
+      placeValue(newBoard, listMove[j].section, listMove[j].cell, listMove[j].value);
       if (scanBoard(newBoard, newConstraint) == 0) {
         gettimeofday(&real_end, NULL);
 
@@ -256,6 +534,7 @@ void scanConstraintsPthread(SuDoku Board) {
         cp_thread_data_array[j].board = newBoard;
         cp_thread_data_array[j].curCell = listMove[j];
         cp_thread_data_array[j].constraint = newConstraint;
+        cp_thread_data_array[j].search = &Search;
 
         rc = pthread_create(&thread[j], &attr, pthread_callConstraintPropagation, &cp_thread_data_array[j]);
         if (rc) { printf("Error: return code from pthread_create() is %d\n",rc); exit(-1); }
@@ -273,6 +552,7 @@ void scanConstraintsPthread(SuDoku Board) {
           exit(-1);}
       }
     }
+    printSearchFailure(&Search);
     exit(0);
 
   }
@@ -288,6 +568,395 @@ void scanConstraintsPthread(SuDoku Board) {
 
 }
 
+/******************************************************************************/
+int triageBenchmarkBoard(SuDoku *board, int *strategy) {
+/******************************************************************************/
+/*
+ * Print the solution of a benchmark puzzle that propagation finishes on
+ * its own, without forking.  Returns 1 if the puzzle needs a search,
+ * leaving the board as far as propagation got and the -A strategy of the
+ * board as it was given.
+ *
+ */
+  SuDoku solved;
+
+  telemetryBegin(0);
+  *strategy = boardStrategy(board);
+  if (triageBoard(board, &solved) != 0) {
+    memcpy(board, &solved, sizeof(SuDoku));
+    telemetryIdle(0);
+    return(1);
+  }
+
+  printBoardBenchmark(&solved);
+  telemetryEnd(0);
+  benchmark++;
+  return(0);
+}
+
+/******************************************************************************/
+void solveBenchmarkBoard(SuDoku *board, FILE *fin, int thread, int portfolio, int strategy) {
+/******************************************************************************/
+/*
+ * Solve one puzzle of a benchmark in a child process, which prints its
+ * own result line.  Under -A the search takes strategy, chosen before
+ * the board was propagated.
+ *
+ */
+  board_constraint Constraint;
+  pid_t child_pid;
+
+  fflush(stdout);
+  telemetryBegin(0);
+  child_pid = fork();
+  if (child_pid == 0) {
+    fclose(fin);
+    resetSearch(&Search, node_limit, time_limit);
+    if (adaptive != 0) { applyStrategy(&Search, strategy); }
+    if (portfolio > 1) {
+      solvePortfolioBoard(board, portfolio);
+    } else if (thread == 0) {
+      resetConstraint(&Constraint);
+      updateConstraint(board, &Constraint);
+
+      constraintPropagation (board, &Constraint, chooseMove(board, &Constraint, &Search), solutionFunc, &Search);
+      printSearchFailure(&Search);
+    } else {
+      scanConstraintsPthread(*board);
+    }
+    exit(0);
+  } else {
+    waitpid(child_pid, NULL, 0);
+    telemetryEnd(0);
+    benchmark++;
+  }
+}
+
+/******************************************************************************/
+void resumeBenchmark(FILE *fin, int resume, int *propagated) {
+/******************************************************************************/
+/*
+ * Check that a checkpointed run reads and writes files, and when resuming
+ * go back to the last checkpoint: the input offset, the output cut back
+ * to what had been written for the puzzles before it, the counts and the
+ * time so far.
+ *
+ */
+  checkpoint Checkpoint;
+  struct stat st;
+
+  if (fseek(fin, 0, SEEK_CUR) != 0 || fstat(STDOUT_FILENO, &st) != 0 || S_ISREG(st.st_mode) == 0) {
+    fprintf(stderr, "Error: -K needs the input and the output to be files\n");
+    exit(1);
+  }
+
+  if (resume == 1) {
+    if (readCheckpoint(checkpoint_file, &Checkpoint) != 0) {
+      fprintf(stderr, "Error: no checkpoint in '%s'\n", checkpoint_file);
+      exit(1);
+    }
+    if (st.st_size < Checkpoint.output) {
+      fprintf(stderr, "Error: the output is shorter than the checkpoint, append to it with >>\n");
+      exit(1);
+    }
+    if (ftruncate(STDOUT_FILENO, Checkpoint.output) != 0 || lseek(STDOUT_FILENO, Checkpoint.output, SEEK_SET) < 0 || fseek(fin, Checkpoint.input, SEEK_SET) != 0) {
+      fprintf(stderr, "Error: could not resume from '%s'\n", checkpoint_file);
+      exit(1);
+    }
+
+    benchmark = Checkpoint.puzzles + 1;
+    *propagated = Checkpoint.lane_solved;
+    real_start.tv_sec -= Checkpoint.usec / 1000000;
+    real_start.tv_usec -= Checkpoint.usec % 1000000;
+    if (real_start.tv_usec < 0) {
+      real_start.tv_sec--;
+      real_start.tv_usec += 1000000;
+    }
+  }
+
+  gettimeofday(&checkpoint_last, NULL);
+}
+
+/******************************************************************************/
+void checkpointBenchmark(FILE *fin, int propagated, int force) {
+/******************************************************************************/
+/*
+ * Write a checkpoint after the puzzles finished so far, at most once
+ * every CHECKPOINT_MSEC unless forced.
+ *
+ */
+  checkpoint Checkpoint;
+  struct timeval now;
+
+  if (checkpoint_file == NULL) { return; }
+
+  gettimeofday(&now, NULL);
+  if (force == 0 && (now.tv_sec - checkpoint_last.tv_sec) * 1000 + (now.tv_usec - checkpoint_last.tv_usec) / 1000 < CHECKPOINT_MSEC) {
+    return;
+  }
+  checkpoint_last = now;
+
+  fflush(stdout);
+  Checkpoint.input = ftell(fin);
+  Checkpoint.output = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+  Checkpoint.puzzles = benchmark - 1;
+  Checkpoint.lane_solved = propagated;
+  Checkpoint.usec = (now.tv_sec - real_start.tv_sec) * 1000000 + now.tv_usec - real_start.tv_usec;
+
+  if (writeCheckpoint(checkpoint_file, &Checkpoint) != 0) {
+    fprintf(stderr, "Error: could not write checkpoint '%s'\n", checkpoint_file);
+    exit(1);
+  }
+}
+
+/******************************************************************************/
+void shardResultFunc(shard_result *result) {
+/******************************************************************************/
+
+  switch (result->status) {
+    case SEARCH_SOLVED:
+      printBoardBenchmark(&result->board);
+      break;
+    case SHARD_CRASHED:
+      printf("crashed\n");
+      break;
+    default:
+      printf("%s\tnodes: %ld\tdead ends: %ld\ttime: %.3f sec\n", (result->status == SEARCH_ABORTED) ? "timeout" : "unsolvable",
+          result->nodes, result->dead_ends, result->msec / 1000.0);
+      break;
+  }
+  benchmark++;
+}
+
+/******************************************************************************/
+void shardBenchmark(char *filename, int shards, int portfolio, int probes) {
+/******************************************************************************/
+/*
+ * Run a benchmark file on shards worker processes, printing the results
+ * in input order and the totals of every shard.  With probes, the workers
+ * take the puzzles hardest first instead of a byte range each.
+ *
+ */
+  shard_stats stats;
+
+  if (strncmp("-", filename, 1) == 0) {
+    printf("Error: -W needs a file it can seek in, not standard input\n");
+    exit(1);
+  }
+
+  resetSearch(&Search, node_limit, time_limit);
+  printf("\n");
+  if (probes > 0) {
+    runScheduled(filename, shards, &Search, portfolio, probes, shardResultFunc, &stats);
+  } else {
+    runShards(filename, shards, &Search, portfolio, shardResultFunc, &stats);
+  }
+  telemetryStop();
+
+  printf("\n%ld puzzles: %ld solved, %ld unsolvable, %ld timeout, %ld crashed\n", stats.puzzles, stats.solved, stats.unsolvable, stats.aborted, stats.crashed);
+  printf("%ld solved by propagation, %ld searched\n", stats.propagated, stats.puzzles - stats.propagated - stats.crashed);
+  printf("%ld nodes, %ld dead ends, %ld worker restarts\n", stats.nodes, stats.dead_ends, stats.restarts);
+
+  benchmark = 0;
+  gettimeofday(&real_end, NULL);
+  printSummary();
+}
+
+/******************************************************************************/
+void solveMultiGridBoard(char *filename, int print_only) {
+/******************************************************************************/
+/*
+ * Load the grids of a layout file and solve them together, or just print
+ * them.
+ *
+ */
+  multi_grid *multi;
+
+  multi = malloc(sizeof(multi_grid));
+  loadMultiGrid(multi, filename);
+
+  if (print_only == 1) {
+    printMultiGrid(multi);
+    free(multi);
+    return;
+  }
+
+  resetSearch(&Search, node_limit, time_limit);
+  if (solveMultiGrid(multi, &Search) != SEARCH_SOLVED) {
+    printSearchFailure(&Search);
+    free(multi);
+    return;
+  }
+
+  gettimeofday(&real_end, NULL);
+  printMultiGrid(multi);
+  printf("\nSolved %d grids as one after %ld nodes\n", multi->count, Search.nodes);
+  printSummary();
+  free(multi);
+}
+
+/******************************************************************************/
+void solvePortfolioBoard(SuDoku *board, int members) {
+/******************************************************************************/
+  int winner;
+
+  winner = solvePortfolio(board, members, &Search);
+  if (winner == -1) {
+    printSearchFailure(&Search);
+    return;
+  }
+
+  gettimeofday(&real_end, NULL);
+  if (benchmark == 0) {
+    printBoard(board);
+    printf("\nSolved by portfolio member %d after %ld nodes\n", winner, Search.nodes);
+    printSummary();
+  } else {
+    printBoardBenchmark(board);
+  }
+}
+
+/******************************************************************************/
+void runSession(SuDoku *board) {
+/******************************************************************************/
+/*
+ * Serve a play session on stdin, one command per line and one reply line
+ * per command (print replies with the board).  Cells are addressed as
+ * section and cell, 1 through 9.
+ *
+ *   place S C V   erase S C   undo   hint   solvable   conflicts   print   quit
+ *
+ */
+  sudoku_session Session;
+  c_address list[81], move;
+  char line[256], command[16];
+  int section, cell, value, technique, count, i;
+  char *techniques[] = { "none", "naked", "hidden" };
+  char *answers[] = { "solvable", "unsolvable", "unknown" };
+
+  sessionStart(&Session, board);
+
+  while (fgets(line, sizeof(line), stdin) != NULL) {
+    if (sscanf(line, "%15s", command) != 1) { continue; }
+
+    if (strcmp(command, "place") == 0 && sscanf(line, "%*s %d %d %d", &section, &cell, &value) == 3 && value != 0) {
+      printf("%s\n", (sessionPlace(&Session, section, cell, value) == 0) ? "ok" : "refused");
+    } else if (strcmp(command, "erase") == 0 && sscanf(line, "%*s %d %d", &section, &cell) == 2) {
+      printf("%s\n", (sessionPlace(&Session, section, cell, 0) == 0) ? "ok" : "refused");
+    } else if (strcmp(command, "undo") == 0) {
+      printf("%s\n", (sessionUndo(&Session) == 0) ? "ok" : "refused");
+    } else if (strcmp(command, "hint") == 0) {
+      move = sessionHint(&Session, &technique);
+      if (technique == HINT_NONE) {
+        printf("none\n");
+      } else {
+        printf("%d %d %d %s\n", move.section, move.cell, move.value, techniques[technique]);
+      }
+    } else if (strcmp(command, "solvable") == 0) {
+      printf("%s\n", answers[ sessionSolvable(&Session, node_limit) ]);
+    } else if (strcmp(command, "conflicts") == 0) {
+      count = sessionConflicts(&Session, &list[0]);
+      printf("%d", count);
+      for (i=0; i<count; i++) {
+        printf(" (%d, %d)", list[i].section, list[i].cell);
+      }
+      printf("\n");
+    } else if (strcmp(command, "print") == 0) {
+      printBoard(&Session.board);
+    } else if (strcmp(command, "quit") == 0) {
+      break;
+    } else {
+      printf("error\n");
+    }
+    fflush(stdout);
+  }
+
+  free(Session.history);
+}
+
+/******************************************************************************/
+void enumerationFunc(SuDoku *board) {
+/******************************************************************************/
+
+  printBoardBenchmark(board);
+}
+
+/******************************************************************************/
+void enumerateBoard(SuDoku *board, int count_only, int thread) {
+/******************************************************************************/
+/*
+ * Stream every solution of the board to stdout, or just count them, on
+ * every processor with -t.  The count goes to stderr so the solutions
+ * can be piped on as they are.
+ *
+ */
+  solution_iterator *iterator;
+  SuDoku solution;
+  long count = 0;
+
+  if (thread != 0) {
+    count = enumerateParallel(board, sysconf(_SC_NPROCESSORS_ONLN), (count_only != 0) ? NULL : enumerationFunc);
+  } else {
+    iterator = malloc(sizeof(solution_iterator));
+    iteratorStart(iterator, board);
+    if (count_only != 0) {
+      count = iteratorCount(iterator, 0);
+    } else {
+      while (iteratorNext(iterator, &solution) != 0) {
+        printBoardBenchmark(&solution);
+        count++;
+      }
+    }
+    free(iterator);
+  }
+
+  gettimeofday(&real_end, NULL);
+  if (count_only != 0) {
+    printf("%ld\n", count);
+  }
+  fflush(stdout);
+  fprintf(stderr, "%ld solutions in %.3f sec\n", count, (real_end.tv_sec - real_start.tv_sec) + (real_end.tv_usec - real_start.tv_usec) / 1000000.0);
+}
+
+/******************************************************************************/
+void minimalBoards(SuDoku *board, FILE *fin) {
+/******************************************************************************/
+/*
+ * Check the clues of one board, or of every puzzle in a benchmark file,
+ * on every processor.  Batch results are printed one line per puzzle, in
+ * input order.
+ *
+ */
+  minimal_puzzle *puzzles = NULL;
+  int count = 0, size = 0, i;
+
+  if (fin == NULL) {
+    puzzles = malloc(sizeof(minimal_puzzle));
+    memcpy(&puzzles[0].board, board, sizeof(SuDoku));
+    count = 1;
+  }
+  while (fin != NULL) {
+    if (count == size) {
+      size = size * 2 + 64;
+      puzzles = realloc(puzzles, size * sizeof(minimal_puzzle));
+    }
+    if (loadBenchmark(&puzzles[count].board, fin) != 0) { break; }
+    count++;
+  }
+
+  checkMinimal(puzzles, count, sysconf(_SC_NPROCESSORS_ONLN));
+
+  for (i=0; i<count; i++) {
+    if (fin == NULL) { printBoard(&puzzles[i].board); }
+    printMinimal(&puzzles[i]);
+  }
+
+  gettimeofday(&real_end, NULL);
+  fflush(stdout);
+  fprintf(stderr, "%d puzzles checked in %.3f sec\n", count, (real_end.tv_sec - real_start.tv_sec) + (real_end.tv_usec - real_start.tv_usec) / 1000000.0);
+  free(puzzles);
+}
+
 /******************************************************************************/
 void printSummary( void ) {
 /******************************************************************************/
@@ -305,3 +974,30 @@ void printSummary( void ) {
   }
 }
 
+
+/******************************************************************************/
+void printSearchFailure(search_state *search) {
+/******************************************************************************/
+/*
+ * Called when a search returns without finding a solution, either because
+ * the budget ran out or because the puzzle has none.
+ *
+ */
+  char *reason;
+
+  gettimeofday(&real_end, NULL);
+
+  if (search->aborted != 0) {
+    reason = "timeout";
+  } else {
+    reason = "unsolvable";
+  }
+
+  if ( benchmark == 0 ) {
+    printf("No solution: %s after %ld nodes, %ld dead ends, %ld backjumps\n", reason, search->nodes, search->dead_ends, search->backjumps);
+    printSummary();
+  } else {
+    printf("%s\tnodes: %ld\tdead ends: %ld\ttime: %.3f sec\n", reason, search->nodes, search->dead_ends, searchElapsed(search) / 1000.0);
+    telemetryResult(0, (search->aborted != 0) ? SEARCH_ABORTED : SEARCH_CONTINUE);
+  }
+}
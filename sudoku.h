@@ -29,15 +29,10 @@
  * More specialized test which takes into consideration the row and column
  * values intersecting the cell.
  *
- * determineRow
- * ------------
- * Figures out the indexes for each section and cell that intersect
- * the row that a specified cell is in.
- *
- * determineCol
- * ------------
- * Figures out the indexes for each section and cell that intersect
- * the column that a specified cell is in.
+ * cellIndex
+ * ---------
+ * Position of a section and cell on the board counted row by row
+ * from the top left, 0 through 80.
  *
  * oneMoveLeft
  * -----------
@@ -51,6 +46,50 @@
  * -----------------
  * Finds the next available cell on the board for a given value.
  *
+ * dropCandidate
+ * -------------
+ * Remove a candidate of a cell, moving the cell down one count bucket.
+ * Code that narrows a constraint should go through this, so the buckets
+ * findLeastConstrained and findConstrainedMove read stay in step.  The
+ * reason is the set of search decisions the removal follows from, as
+ * levelBit bits, which the search uses to jump back over decisions that
+ * had nothing to do with a dead end.  Reasons are gathered per cell, not
+ * per candidate, to keep the constraint the search copies at every node
+ * small.
+ *
+ * constraintConflict
+ * ------------------
+ * The decisions behind the contradiction checkConstraintRules found.
+ *
+ * placeValue
+ * ----------
+ * Set one cell, keeping the Zobrist hash of the board up to date.  Any
+ * code that changes a board during a search should go through this.
+ *
+ * boardHash
+ * ---------
+ * Compute the Zobrist hash of a board from scratch, the XOR of one random
+ * key per filled cell and value.  The keys are only generated once
+ * loadZobrist has been called, until then every hash is zero.
+ *
+ * loadUnits
+ * ---------
+ * Fill the unit table with the classic units: the nine sections, the
+ * rows and the columns.  A unit is any nine cells that hold every value
+ * once.  The rules, the constraints and the search only ever look at
+ * units through this table, so variants only change the table.
+ *
+ * addUnit
+ * -------
+ * Add a unit from a "unit" line of the board file, such as a diagonal or
+ * an extra window, or a jigsaw region from a "region" line.  Nine regions
+ * replace the sections as units.
+ *
+ * linkUnits
+ * ---------
+ * Derive the peers of every cell and the pairs of units that overlap from
+ * the unit table.  Called after the table changes.
+ *
  */
 
 /* One 3x3 section of the 9x9 SuDoku board */
@@ -61,6 +100,7 @@ typedef struct section {
 /* An entire 9x9 board of 3x3 sections */
 typedef struct sudoku {
         Section section[10];
+        unsigned long long hash;
 } SuDoku;
 
 /* The address of one cell including possible value */
@@ -80,17 +120,289 @@ typedef struct section_constraint {
 	cell_constraint cell[10];
 } section_constraint;
 
+#define MAX_UNITS	64
+#define MAX_PEERS	80
+
+#define CELL_PLACED	-1	/* candidate count of a cell whose value updateConstraint has applied */
+#define CONFLICT_LEVELS	31	/* decision levels told apart, deeper ones share the top bit */
+
 /* A board of 9 sections containing cell constraints */
 typedef struct board_constraint {
 	section_constraint section[10];
+	unsigned int seen[2][MAX_UNITS];	/* unit signatures the costly tiers last saw, 0 for none */
+	signed char candidates[10][10];		/* candidates left in each cell, or CELL_PLACED */
+	unsigned long long bucket[10][2];	/* cells by candidate count, bit (section-1)*9 + cell-1 */
+	unsigned int why[10][10];		/* decisions behind the candidates each cell lost */
+	unsigned int placed_why[10][10];	/* decisions behind each placed value, 0 until known */
+	int depth;				/* decision level the constraint belongs to */
+	unsigned int conflict;			/* decisions behind the last dead end below it */
 } board_constraint;
 
-void determineRow(int*, int*, int, int);
-void determineCol(int*, int*, int, int);
+/* Zobrist keys, one per section, cell and value */
+unsigned long long zobrist[10][10][10];
+
+/* The tiers of updateConstraint */
+#define TIER_PEERS	0	/* values placed in peers, and killer cages */
+#define TIER_SINGLES	1	/* hidden singles */
+#define TIER_LINES	2	/* unit intersections */
+#define TIER_PAIRS	3	/* hidden pairs */
+#define PROPAGATE_TIERS	4
+
+/* How often each tier ran and made progress, shared by forked processes */
+typedef struct tier_stats {
+	long runs[PROPAGATE_TIERS];
+	long hits[PROPAGATE_TIERS];
+	long checked[PROPAGATE_TIERS];	/* units, or pairs of units for intersections */
+	long skipped[PROPAGATE_TIERS];	/* unchanged since the tier last saw them */
+} tier_stats;
+
+tier_stats *propagation_stats = NULL;
+pid_t propagation_stats_pid = 0;
+
+#define TIER_COUNT(field, tier, n) \
+  do { if (propagation_stats != NULL) { __sync_fetch_and_add(&propagation_stats->field[(tier)], (n)); } } while (0)
+
+/* Two units sharing more than one cell, by their positions 0-8 */
+typedef struct unit_pair {
+	int a;
+	int b;
+	int a_shared;	/* positions of a that are also in b */
+	int b_only;	/* positions of b that are not in a */
+} unit_pair;
+
+/* Every unit of the puzzle, nine cells each */
+c_address units[MAX_UNITS][9];
+int unit_count = 0;
+int unit_boxes = 1;		/* the sections are units, not jigsaw regions */
+int region_count = 0;
+
+/* The cells sharing a unit with each section and cell */
+c_address cell_peers[10][10][MAX_PEERS];
+int cell_peer_count[10][10];
+
+unit_pair unit_pairs[MAX_UNITS * MAX_UNITS];
+int unit_pair_count = 0;
+
 void printConstraint(SuDoku*, board_constraint*);
 void printBoard(SuDoku*);
 int valueCellAvailable(SuDoku*, c_address, int);
-int checkRowCol(SuDoku*, int, int);
+
+void loadUnits(void);
+void linkUnits(void);
+int parseCell(char*, c_address*);
+int addUnit(char*, char*);
+
+/* Killer cages, see include/killer.h */
+int addCage(char*, char*);
+void cageConstraint(SuDoku*, board_constraint*);
+int checkCages(SuDoku*);
+extern int killer_cage_count;
+
+void loadZobrist( void ) {
+/*
+ * Fill the Zobrist keys from a fixed seed, so hashes are the same in
+ * every run and every process.
+ *
+ */
+
+  unsigned long long seed = 0x5344754B6F4B696CULL, z;
+  int i,j,k;
+
+  for (i=0; i<10; i++) {
+    for (j=0; j<10; j++) {
+      for (k=0; k<10; k++) {
+        z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        zobrist[i][j][k] = (k == 0) ? 0 : z ^ (z >> 31);
+      }
+    }
+  }
+}
+
+unsigned long long boardHash(SuDoku *board) {
+  unsigned long long hash = 0;
+  int i,j;
+
+  for (i=1; i<=9; i++) {
+    for (j=1; j<=9; j++) {
+      hash ^= zobrist[i][j][ board->section[i].cell[j] ];
+    }
+  }
+  return(hash);
+}
+
+void placeValue(SuDoku *board, int section, int cell, int value) {
+  board->hash ^= zobrist[section][cell][ board->section[section].cell[cell] ] ^ zobrist[section][cell][value];
+  board->section[section].cell[cell] = value;
+}
+
+void loadUnits( void ) {
+  int i,j;
+
+  for (i=0; i<9; i++) {
+    for (j=0; j<9; j++) {
+      units[i][j].section = i+1;
+      units[i][j].cell = j+1;
+
+      units[9+i][j].section = (i/3)*3 + j/3 + 1;	/* row i */
+      units[9+i][j].cell = (i%3)*3 + j%3 + 1;
+
+      units[18+i][j].section = (j/3)*3 + i/3 + 1;	/* column i */
+      units[18+i][j].cell = (j%3)*3 + i%3 + 1;
+    }
+  }
+  unit_count = 27;
+  unit_boxes = 1;
+  region_count = 0;
+
+  linkUnits();
+}
+
+void linkUnits( void ) {
+  c_address *cell, *peer;
+  unit_pair *pair;
+  int i,j,k,u,v,count;
+
+  for (i=1; i<=9; i++) {
+    for (j=1; j<=9; j++) {
+      cell_peer_count[i][j] = 0;
+    }
+  }
+
+  for (u=0; u<unit_count; u++) {
+    for (j=0; j<9; j++) {
+      cell = &units[u][j];
+      for (k=0; k<9; k++) {
+        peer = &units[u][k];
+        if (k == j) { continue; }
+
+        for (i=0; i<cell_peer_count[cell->section][cell->cell]; i++) {
+          if (cell_peers[cell->section][cell->cell][i].section == peer->section &&
+              cell_peers[cell->section][cell->cell][i].cell == peer->cell) { break; }
+        }
+        if (i == cell_peer_count[cell->section][cell->cell]) {
+          cell_peers[cell->section][cell->cell][i] = *peer;
+          cell_peer_count[cell->section][cell->cell]++;
+        }
+      }
+    }
+  }
+
+  unit_pair_count = 0;
+  for (u=0; u<unit_count; u++) {
+    for (v=0; v<unit_count; v++) {
+      if (u == v) { continue; }
+
+      pair = &unit_pairs[unit_pair_count];
+      pair->a = u;
+      pair->b = v;
+      pair->a_shared = 0;
+      pair->b_only = 0x1FF;
+      count = 0;
+      for (j=0; j<9; j++) {
+        for (k=0; k<9; k++) {
+          if (units[u][j].section == units[v][k].section && units[u][j].cell == units[v][k].cell) {
+            pair->a_shared |= 1 << j;
+            pair->b_only &= ~(1 << k);
+            count++;
+          }
+        }
+      }
+      if (count > 1 && count < 9) { unit_pair_count++; }
+    }
+  }
+}
+
+int parseCell(char *token, c_address *cell) {
+/*
+ * Read a cell given by row and column, "r1c9", into a section and cell.
+ * Returns 1 if the token is not a cell.
+ *
+ */
+
+  int row, col;
+
+  if (sscanf(token, "r%dc%d", &row, &col) != 2 || row < 1 || row > 9 || col < 1 || col > 9) {
+    return(1);
+  }
+  cell->section = ((row-1)/3)*3 + (col-1)/3 + 1;
+  cell->cell = ((row-1)%3)*3 + (col-1)%3 + 1;
+  cell->value = 0;
+  return(0);
+}
+
+int addUnit(char *line, char *fname) {
+  c_address cells[9];
+  char *token;
+  int region, count, i;
+
+  token = strtok(line, " \t\r\n");
+  region = (strcmp(token, "region") == 0);
+
+  count = 0;
+  while ((token = strtok(NULL, " \t\r\n")) != NULL) {
+    if (count == 9 || parseCell(token, &cells[count]) != 0) {
+      printf("Error: bad unit cell '%s' in '%s'\n", token, fname);
+      exit(1);
+    }
+    for (i=0; i<count; i++) {
+      if (cells[i].section == cells[count].section && cells[i].cell == cells[count].cell) {
+        printf("Error: unit repeats cell '%s' in '%s'\n", token, fname);
+        exit(1);
+      }
+    }
+    count++;
+  }
+  if (count != 9) {
+    printf("Error: unit of %d cells in '%s', units have 9\n", count, fname);
+    exit(1);
+  }
+
+  if (region) {		/* regions take the place of the sections */
+    if (region_count == 9) {
+      printf("Error: more than 9 regions in '%s'\n", fname);
+      exit(1);
+    }
+    memcpy(&units[region_count][0], &cells[0], sizeof(cells));
+    region_count++;
+    unit_boxes = 0;
+  } else {
+    if (unit_count == MAX_UNITS) {
+      printf("Error: more than %d units in '%s'\n", MAX_UNITS, fname);
+      exit(1);
+    }
+    memcpy(&units[unit_count][0], &cells[0], sizeof(cells));
+    unit_count++;
+  }
+
+  return(0);
+}
+
+void checkRegions(char *fname) {
+/*
+ * Jigsaw regions must cover every cell of the board exactly once.
+ *
+ */
+
+  int covered[10][10];
+  int i,j;
+
+  memset(covered, 0, sizeof(covered));
+  for (i=0; i<region_count; i++) {
+    for (j=0; j<9; j++) {
+      covered[ units[i][j].section ][ units[i][j].cell ]++;
+    }
+  }
+  for (i=1; i<=9; i++) {
+    for (j=1; j<=9; j++) {
+      if (region_count != 9 || covered[i][j] != 1) {
+        printf("Error: the regions in '%s' do not cover the board once\n", fname);
+        exit(1);
+      }
+    }
+  }
+}
 
 void resetBoard(SuDoku *board) {
 /*
@@ -106,6 +418,7 @@ void resetBoard(SuDoku *board) {
       board->section[i].cell[j] = 0;
     }
   }
+  board->hash = 0;
 }
 
 void resetConstraint( board_constraint *constraint) {
@@ -123,143 +436,392 @@ void resetConstraint( board_constraint *constraint) {
       }
     }
   }
+  memset(constraint->seen, 0, sizeof(constraint->seen));
+
+  memset(constraint->candidates, 9, sizeof(constraint->candidates));
+  memset(constraint->bucket, 0, sizeof(constraint->bucket));
+  constraint->bucket[9][0] = ~0ULL;
+  constraint->bucket[9][1] = (1ULL << (81 - 64)) - 1;
+
+  memset(constraint->why, 0, sizeof(constraint->why));
+  memset(constraint->placed_why, 0, sizeof(constraint->placed_why));
+  constraint->depth = 0;
+  constraint->conflict = 0;
+}
+
+unsigned int levelBit(int level) {
+  if (level == 0) { return(0); }
+  return(1u << ((level < CONFLICT_LEVELS) ? level : CONFLICT_LEVELS));
+}
+
+unsigned int levelsUpTo(int level) {
+/*
+ * Every decision down to level, for dead ends nobody can explain.
+ *
+ */
+
+  if (level >= CONFLICT_LEVELS) { return(~1u); }
+  return(((2u << level) - 1) & ~1u);
+}
+
+void dropCandidate(board_constraint *constraint, int section, int cell, int value, unsigned int why) {
+  int index, count;
+
+  if (constraint->section[section].cell[cell].value[value] == 0) { return; }
+  constraint->section[section].cell[cell].value[value] = 0;
+  constraint->why[section][cell] |= why;
+
+  count = constraint->candidates[section][cell];
+  if (count == CELL_PLACED) { return; }
+  index = (section-1)*9 + cell-1;
+  constraint->bucket[count][index >> 6] &= ~(1ULL << (index & 63));
+  constraint->bucket[count-1][index >> 6] |= 1ULL << (index & 63);
+  constraint->candidates[section][cell] = count - 1;
+}
+
+int bucketCell(SuDoku *board, board_constraint *constraint, int count, c_address *theCell) {
+/*
+ * The first open cell, in section order, with count candidates.  Returns
+ * 0 if there is none.  Placed cells the constraint has not caught up with
+ * yet are passed over.
+ *
+ */
+
+  unsigned long long bits;
+  int word, index;
+
+  for (word=0; word<2; word++) {
+    for (bits = constraint->bucket[count][word]; bits != 0; bits &= bits - 1) {
+      index = word * 64 + __builtin_ctzll(bits);
+      theCell->section = index / 9 + 1;
+      theCell->cell = index % 9 + 1;
+      if (board == NULL || board->section[ theCell->section ].cell[ theCell->cell ] == 0) { return(1); }
+    }
+  }
+  return(0);
+}
+
+unsigned int cellWhy(board_constraint *constraint, int section, int cell) {
+/*
+ * The decisions behind every candidate a cell has lost.
+ *
+ */
+
+  return(constraint->why[section][cell]);
+}
+
+unsigned int unitWhy(board_constraint *constraint, int u, int positions) {
+/*
+ * The decisions behind what every cell of unit u outside the positions
+ * mask lost.  Reasons are kept per cell, so this covers whichever value
+ * those cells lost, at the price of a jump now and then, never a
+ * solution.
+ *
+ */
+
+  unsigned int why = 0;
+  int j;
+
+  for (j=0; j<9; j++) {
+    if ((positions & (1 << j)) == 0) { why |= constraint->why[ units[u][j].section ][ units[u][j].cell ]; }
+  }
+  return(why);
+}
+
+void settleCell(board_constraint *constraint, int section, int cell) {
+/*
+ * Take a placed cell out of the buckets.  A value placed without a known
+ * reason was forced by the candidates the cell lost, and the candidates
+ * it still had are gone for the same reason as the value is there.
+ *
+ */
+
+  int index, count;
+
+  if (constraint->placed_why[section][cell] == 0) {
+    constraint->placed_why[section][cell] = cellWhy(constraint, section, cell);
+  }
+  constraint->why[section][cell] |= constraint->placed_why[section][cell];
+
+  index = (section-1)*9 + cell-1;
+  count = constraint->candidates[section][cell];
+  constraint->bucket[count][index >> 6] &= ~(1ULL << (index & 63));
+  constraint->candidates[section][cell] = CELL_PLACED;
+  memset(&constraint->section[section].cell[cell], 0, sizeof(cell_constraint));
+}
+
+void unitPositions(board_constraint *constraint, int position[][10]) {
+/*
+ * For every unit and value, a mask of the unit's positions where the
+ * value is still a candidate.
+ *
+ */
+
+  cell_constraint *c;
+  int u,j,k;
+
+  for (u=0; u<unit_count; u++) {
+    for (k=1; k<=9; k++) {
+      position[u][k] = 0;
+    }
+    for (j=0; j<9; j++) {
+      c = &constraint->section[ units[u][j].section ].cell[ units[u][j].cell ];
+      for (k=1; k<=9; k++) {
+        if (c->value[k] == 1) { position[u][k] |= 1 << j; }
+      }
+    }
+  }
+}
+
+unsigned int unitSignature(int position[10]) {
+/*
+ * A hash of a unit's candidate positions, never zero.
+ *
+ */
+
+  unsigned int h = 0x811C9DC5;
+  int k;
+
+  for (k=1; k<=9; k++) {
+    h = (h ^ position[k]) * 0x01000193;
+  }
+  return(h | 1);
+}
+
+int candidatePositions(SuDoku *board, board_constraint *constraint, int position[][10]) {
+/*
+ * unitPositions, reading each cell once.  Returns 1 if an open cell is
+ * down to one candidate, which scanBoard can place as it is, 2 if an open
+ * cell has none left, and 0 otherwise.
+ *
+ */
+
+  cell_constraint *c;
+  int mask[10][10], result = 0;
+  int i,j,k,u,m;
+
+  for (i=1; i<=9; i++) {
+    for (j=1; j<=9; j++) {
+      c = &constraint->section[i].cell[j];
+      m = 0;
+      for (k=1; k<=9; k++) {
+        if (c->value[k] == 1) { m |= 1 << k; }
+      }
+      mask[i][j] = m;
+      if (board->section[i].cell[j] == 0) {
+        if (m == 0) { return(2); }
+        if ((m & (m - 1)) == 0) { result = 1; }
+      }
+    }
+  }
+
+  for (u=0; u<unit_count; u++) {
+    for (k=1; k<=9; k++) {
+      position[u][k] = 0;
+    }
+    for (j=0; j<9; j++) {
+      for (m = mask[ units[u][j].section ][ units[u][j].cell ]; m != 0; m &= m - 1) {
+        position[u][ __builtin_ctz(m) ] |= 1 << j;
+      }
+    }
+  }
+  return(result);
 }
 
 void updateConstraint(SuDoku *board, board_constraint *constraint) {
 /*
  * Update the constraint values based on the current board.
  *
+ * The techniques run in tiers of growing cost.  Values placed in peers
+ * and killer cages are always applied, then hidden singles.  Unit
+ * intersections only run when neither leaves a single for scanBoard to
+ * place, and hidden pairs only when the intersections remove nothing
+ * either.  Whatever a costlier tier removes sends the work back to the
+ * cheap tiers.  The two costly tiers skip the units (or pairs of units)
+ * whose candidates have not changed since they last looked at them.
+ *
  */
 
-  int i,j,k,l,m;
-  int row_sections[3],row_cells[3];
-  int col_sections[3],col_cells[3];
-  int section, section_count, available, intersect;
-  int subset_cells[9];
-  c_address thisCell;
+  int i,j,k,l,u,value,round,open,found,changed;
+  unsigned int why;
+  int position[MAX_UNITS][10];
+  unsigned int signature[MAX_UNITS];
+  long checked, skipped;
+  unit_pair *pair;
+  c_address *peer;
+  cell_constraint *c;
+
+  if (unit_count == 0) { loadUnits(); }
 
- /* Eliminate naked singles */
+ /* Tier 0: values placed in peers, and killer cages */
+  TIER_COUNT(runs, TIER_PEERS, 1);
   for (i=1; i<=9; i++) {
     for (j=1; j<=9; j++) {
-      if (board->section[i].cell[j] != 0) {
-        for (k=1; k<=9; k++) {
-          constraint->section[i].cell[j].value[k] = 0;
-        }
-      } else {
-        for (k=1; k<=9; k++) {
-          thisCell.section = i;
-          thisCell.cell = j;
-          if (valueCellAvailable(board, thisCell, k) != 0) {
-            constraint->section[i].cell[j].value[k] = 0;
-          }
+      value = board->section[i].cell[j];
+
+     /* Candidates only ever shrink, so a value applied once stays applied */
+      if (value != 0 && constraint->candidates[i][j] != CELL_PLACED) {
+        settleCell(constraint, i, j);
+        for (k=0; k<cell_peer_count[i][j]; k++) {
+          peer = &cell_peers[i][j][k];
+          dropCandidate(constraint, peer->section, peer->cell, value, constraint->placed_why[i][j]);
         }
       }
     }
   }
 
- /* Reduce Line/Box Intersections */
-  for (i=1; i<=9; i+=4)
-    for (j=1; j<=9; j+=4) {
-      determineRow(&row_sections[0], &row_cells[0], i, j);
-      determineCol(&col_sections[0], &col_cells[0], i, j);
+  if (killer_cage_count != 0) {
+    cageConstraint(board, constraint);
+  }
 
-      for (k=1; k<=9; k++) {	/* each number */
+  for (round=0; ; round++) {
+    open = candidatePositions(board, constraint, position);
+    if (open != 0) {		/* a naked single to place, or a dead cell */
+      if (round == 0 && open == 1) { TIER_COUNT(hits, TIER_PEERS, 1); }
+      return;
+    }
 
-       /* Find rows where number can only exist in one section.  Then update constraints for that section */
-        section = 0;
-        section_count = 0;
-        for (l=0; l<3; l++) {		/* each row and column section */
-          available = 0;
-          for (m=0; m<3; m++) {			/* each row and column cell */
-            if (constraint->section[ row_sections[l] ].cell[ row_cells[m] ].value[k] == 1) {
-              available = 1;
-              section = row_sections[l];
-            }
-          }
-          if (available == 1) {section_count++;}
-        }
-        if (section_count == 1) {
-          for (l=1;l<=9;l++) {
-            intersect = 0;
-            for (m=0;m<3;m++) {
-              if (l == row_cells[m]) { intersect = 1; }
-            }
-            if (intersect != 1) { constraint->section[ section ].cell[l].value[k] = 0; }
-          }
-        }
+   /* Tier 1: hidden singles, a number with one place left in a unit */
+    TIER_COUNT(runs, TIER_SINGLES, 1);
+    found = 0;
+    for (u=0; u<unit_count; u++) {
+      for (k=1; k<=9; k++) {
+        if (position[u][k] == 0 || (position[u][k] & (position[u][k] - 1)) != 0) { continue; }
 
-       /* Find cols where number can only exist in one section.  Then update constraints for that section */
-        section = 0;
-        section_count = 0;
-        for (l=0; l<3; l++) {		/* each row and column section */
-          available = 0;
-          for (m=0; m<3; m++) {			/* each row and column cell */
-            if (constraint->section[ col_sections[l] ].cell[ col_cells[m] ].value[k] == 1) {
-              available = 1;
-              section = col_sections[l];
-            }
-          }
-          if (available == 1) {section_count++;}
+        peer = &units[u][ __builtin_ctz(position[u][k]) ];
+        if (constraint->section[ peer->section ].cell[ peer->cell ].value[k] == 0) { continue; }	/* taken by another single, the unit is broken */
+        why = unitWhy(constraint, u, position[u][k]);
+        for (value=1; value<=9; value++) {
+          if (value != k) { dropCandidate(constraint, peer->section, peer->cell, value, why); }
         }
-        if (section_count == 1) {
-          for (l=1;l<=9;l++) {
-            intersect = 0;
-            for (m=0;m<3;m++) {
-              if (l == col_cells[m]) { intersect = 1; }
-            }
-            if (intersect != 1) { constraint->section[ section ].cell[l].value[k] = 0; }
-          }
-        }
-
+        found++;
       }
     }
+    if (found != 0) {
+      TIER_COUNT(hits, TIER_SINGLES, 1);
+      return;
+    }
 
- /* Hidden subsets or hidden pair */
-  for (i=1; i<=9; i++) {	/* each section */
-    for (j=1; j<9; j++) {		/* each first value */
-      for (k=j+1; k<=9; k++) {			/* each paired value */
-        section_count = 0;
-        for (l=1; l<=9; l++) {				/* each cell */
-          if (constraint->section[i].cell[l].value[j] == 1 && constraint->section[i].cell[l].value[k] == 1) {
-            subset_cells[section_count] = l;
-            section_count++;
-          } else if (constraint->section[i].cell[l].value[j] == 1 || constraint->section[i].cell[l].value[k] == 1) {
-            section_count = 3;
-          }
-        }
-        if (section_count == 2) {
-          for (l=1; l<=9; l++) {
-            if (l != j && l != k) {
-              constraint->section[i].cell[ subset_cells[0] ].value[l] = 0;
-              constraint->section[i].cell[ subset_cells[1] ].value[l] = 0;
-            }
+   /* Tier 2: unit intersections, a number confined to the cells one unit shares with another leaves the rest of the other */
+    TIER_COUNT(runs, TIER_LINES, 1);
+    for (u=0; u<unit_count; u++) {
+      signature[u] = unitSignature(position[u]);
+    }
+    changed = 0;
+    checked = 0;
+    skipped = 0;
+    for (i=0; i<unit_pair_count; i++) {
+      pair = &unit_pairs[i];
+      if (signature[pair->a] == constraint->seen[0][pair->a] && signature[pair->b] == constraint->seen[0][pair->b]) {
+        skipped++;
+        continue;
+      }
+      checked++;
+
+      for (k=1; k<=9; k++) {
+        if (position[pair->a][k] == 0 || (position[pair->a][k] & ~pair->a_shared) != 0) { continue; }
+        if ((position[pair->b][k] & pair->b_only) == 0) { continue; }
+
+        why = unitWhy(constraint, pair->a, pair->a_shared);
+        for (j=0; j<9; j++) {
+          if (pair->b_only & (1 << j)) {
+            dropCandidate(constraint, units[pair->b][j].section, units[pair->b][j].cell, k, why);
           }
         }
+        position[pair->b][k] &= ~pair->b_only;
+        changed++;
       }
     }
-  }
+    for (u=0; u<unit_count; u++) {
+      constraint->seen[0][u] = signature[u];
+    }
+    TIER_COUNT(checked, TIER_LINES, checked);
+    TIER_COUNT(skipped, TIER_LINES, skipped);
+    if (changed != 0) {
+      TIER_COUNT(hits, TIER_LINES, 1);
+      continue;
+    }
 
- /* More naked single reduction after line/box is evaluated */
-  for (i=1; i<=9; i++) {	/* each section */
-    for (j=1; j<=9; j++) {		/* each value */
-      section_count = 0;
-      for (k=1; k<=9; k++) {			/* each cell */
-        if (constraint->section[i].cell[k].value[j] == 1) {
-          section_count++;
-          thisCell.section = i;
-          thisCell.cell = k;
-        }
+   /* Tier 3: hidden pairs, two numbers with the same two places left in a unit */
+    TIER_COUNT(runs, TIER_PAIRS, 1);
+    checked = 0;
+    skipped = 0;
+    for (u=0; u<unit_count; u++) {
+      if (signature[u] == constraint->seen[1][u]) {
+        skipped++;
+        continue;
       }
-      if (section_count == 1) {
-        for (k=1; k<=9; k++) {
-          constraint->section[i].cell[ thisCell.cell ].value[k] = 0;
+      constraint->seen[1][u] = signature[u];
+      checked++;
+
+      for (j=1; j<9; j++) {
+        if (__builtin_popcount(position[u][j]) != 2) { continue; }
+        for (k=j+1; k<=9; k++) {
+          if (position[u][k] != position[u][j]) { continue; }
+
+          why = unitWhy(constraint, u, position[u][j]);
+          for (l=0; l<9; l++) {
+            if ((position[u][j] & (1 << l)) == 0) { continue; }
+            c = &constraint->section[ units[u][l].section ].cell[ units[u][l].cell ];
+            for (value=1; value<=9; value++) {
+              if (value != j && value != k && c->value[value] == 1) {
+                dropCandidate(constraint, units[u][l].section, units[u][l].cell, value, why);
+                changed++;
+              }
+            }
+          }
         }
-        constraint->section[i].cell[ thisCell.cell ].value[j] = 1;
       }
     }
+    TIER_COUNT(checked, TIER_PAIRS, checked);
+    TIER_COUNT(skipped, TIER_PAIRS, skipped);
+    if (changed == 0) {
+      return;
+    }
+    TIER_COUNT(hits, TIER_PAIRS, 1);
+  }
+}
+
+void printPropagationStats( void ) {
+/*
+ * Print the counts of each tier of updateConstraint to stderr, from the
+ * process that started counting.
+ *
+ */
+
+  char *names[] = { "peers", "hidden singles", "intersections", "hidden pairs" };
+  int t;
+
+  if (propagation_stats == NULL || getpid() != propagation_stats_pid) { return; }
+
+  fprintf(stderr, "%-16s %12s %12s %8s %14s %14s %8s\n", "tier", "runs", "hits", "hit %", "units checked", "units skipped", "skip %");
+  for (t=0; t<PROPAGATE_TIERS; t++) {
+    fprintf(stderr, "%-16s %12ld %12ld %8.1f %14ld %14ld %8.1f\n", names[t],
+        propagation_stats->runs[t], propagation_stats->hits[t],
+        (propagation_stats->runs[t] != 0) ? 100.0 * propagation_stats->hits[t] / propagation_stats->runs[t] : 0.0,
+        propagation_stats->checked[t], propagation_stats->skipped[t],
+        (propagation_stats->checked[t] + propagation_stats->skipped[t] != 0) ?
+          100.0 * propagation_stats->skipped[t] / (propagation_stats->checked[t] + propagation_stats->skipped[t]) : 0.0);
   }
 }
 
+void startPropagationStats( void ) {
+/*
+ * Count the tiers of updateConstraint from here on, in memory shared with
+ * the processes forked later, and print the counts at exit.
+ *
+ */
+
+  propagation_stats = mmap(NULL, sizeof(tier_stats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (propagation_stats == MAP_FAILED) {
+    printf("Error: could not map the propagation counters\n");
+    exit(1);
+  }
+  memset(propagation_stats, 0, sizeof(tier_stats));
+  propagation_stats_pid = getpid();
+  atexit(printPropagationStats);
+}
+
 void printConstraint(SuDoku *board, board_constraint *constraint) {
   int i,j,k,l,m;
   int col_spacing;
@@ -302,6 +864,10 @@ void loadBoard(SuDoku *board, char *fname) {
  * Empty cells are denoted by 0.  This will load the incomplete
  * board into the board passed as a pointer.
  *
+ * The board may be followed by killer cages, one "cage" line each
+ * (see include/killer.h), and by extra units or jigsaw regions (see
+ * addUnit).
+ *
  * This function tries to be somewhat fault tolerant, however,
  * if the board.txt file is messy, expect this function to fail
  * miserably.
@@ -312,6 +878,9 @@ void loadBoard(SuDoku *board, char *fname) {
 
   FILE *fin;
   int value;
+  char line[1024];
+
+  loadUnits();
 
   if ( strncmp("-", fname, 1) == 0) {
     fin = fdopen(dup(STDIN_FILENO), "r");
@@ -346,15 +915,27 @@ void loadBoard(SuDoku *board, char *fname) {
     }
   }
 
-  value = fgetc(fin);
-  while (value != EOF ) {
-    if ( value > 47 && value < 58 ) {
+  while (fgets(line, sizeof(line), fin) != NULL) {
+    if (strncmp("cage", line, 4) == 0) {
+      addCage(line, fname);
+      continue;
+    }
+    if (strncmp("unit", line, 4) == 0 || strncmp("region", line, 6) == 0) {
+      addUnit(line, fname);
+      continue;
+    }
+    if (strpbrk(line, "0123456789") != NULL) {
       printf ("Error: file '%s' corrupt\n", fname);
       exit(1);
     }
-    value = fgetc(fin);
   }
   fclose(fin);
+  board->hash = boardHash(board);
+
+  if (region_count != 0) {
+    checkRegions(fname);
+  }
+  linkUnits();
 }
 
 int loadBenchmark(SuDoku *board, FILE *fin) {
@@ -382,6 +963,7 @@ int loadBenchmark(SuDoku *board, FILE *fin) {
       }
     }
   }
+  board->hash = boardHash(board);
   value = fgetc(fin);
   if (value == EOF) { return (1); }
 
@@ -444,253 +1026,118 @@ int checkRules (SuDoku *board) {
  *
  */
 
-  int i,j,k;
+  int u,j,value,seen;
 
- /* Check within each section to determine if a nubmer exists more then once */
-  for (i=1; i<=9; i++) {
-    for (j=1; j<9; j++) {
-      for (k=j+1; k<=9; k++) {
-        if (board->section[i].cell[j] == board->section[i].cell[k] && board->section[i].cell[j] != 0) {
-          return(1);
-        }
-      }
-    }
-  }
+  if (unit_count == 0) { loadUnits(); }
 
- /* Check within each column and row using the checkRowCol function */
-  for (i=1; i<=9; i+=4) {
-    for (j=1; j<=9; j+=4) {
-      if (checkRowCol(board, i, j) != 0) {
+ /* Check within each unit to determine if a number exists more then once */
+  for (u=0; u<unit_count; u++) {
+    seen = 0;
+    for (j=0; j<9; j++) {
+      value = board->section[ units[u][j].section ].cell[ units[u][j].cell ];
+      if (value == 0) { continue; }
+      if (seen & (1 << value)) {
         return(1);
       }
+      seen |= 1 << value;
     }
   }
 
+  if (killer_cage_count != 0) {
+    return(checkCages(board));
+  }
+
   return(0);
 }
 
 int checkConstraintRules (SuDoku *board, board_constraint *constraint) {
-  int i,j,k,l,m;
-  int row_sections[3], row_cells[3];
-  int col_sections[3], col_cells[3];
-  int sum,available;
-
- /*
-  * Find cells that are constrained to no options, and sections that are
-  * missing numbers due to constraints
-  */
-  for (i=1; i<=9; i++) {
-    for (j=1; j<9; j++) {
-      sum = 0;
-      available = 0;
-      for (k=1; k<=9; k++) {
-        if (board->section[i].cell[j] == 0) {
-          if (constraint->section[i].cell[j].value[k] == 1) { sum++; }
-        } else {
-          sum = 1;
-        }
-
-        if (board->section[i].cell[k] == j) {
-          available = 1;
-        } else {
-          if (constraint->section[i].cell[k].value[j] == 1) { available = 1; }
-        }
-      }
-      if (sum == 0) {		/* Cell j had no values available */
-        return(1);
-      }
-      if (available == 0) {	/* Value j was not available in section i */
-        return(1);
-      }
-    }
-  }
+  cell_constraint *c;
+  int mask[10][10];
+  int i,j,k,u,value,available;
 
- /* Find rows and columns that are missing values as options due to constraints */
-  for (i=1; i<=9; i+=4) {
-    for (j=1; j<=9; j+=4) {
-      determineRow(&row_sections[0], &row_cells[0], i, j);
-      determineCol(&col_sections[0], &col_cells[0], i, j);
+  if (unit_count == 0) { loadUnits(); }
 
-      for (k=1; k<=9; k++) {
-        available=0;
-        l=0;
-        while (available == 0 && l<3) {
-          m=0;
-          while (available == 0 && m<3) {
-            if (board->section[ row_sections[l] ].cell[ row_cells[m] ] == k || constraint->section[ row_sections[l] ].cell[ row_cells[m] ].value[k] == 1) {
-              available = 1;
-            }
-            m++;
-          }
-          l++;
-        }
-      }
-      if (available == 0) {
-        return(1);
+ /* Find cells that are constrained to no options, masking each cell once for all its units */
+  for (i=1; i<=9; i++) {
+    for (j=1; j<=9; j++) {
+      value = board->section[i].cell[j];
+      if (value != 0) {
+        mask[i][j] = 1 << value;
+        continue;
       }
 
+      c = &constraint->section[i].cell[j];
+      available = 0;
       for (k=1; k<=9; k++) {
-        available=0;
-        l=0;
-        while (available == 0 && l<3) {
-          m=0;
-          while (available == 0 && m<3) {
-            if (board->section[ col_sections[l] ].cell[ col_cells[m] ] == k || constraint->section[ col_sections[l] ].cell[ col_cells[m] ].value[k] == 1) {
-              available = 1;
-            }
-            m++;
-          }
-          l++;
-        }
+        available |= (c->value[k] == 1) << k;
       }
-      if (available == 0) {
+      if (available == 0) {	/* no values available for the cell */
         return(1);
       }
+      mask[i][j] = available;
     }
   }
-  return(0);
-}
-
-void determineRow(int *sections_array, int *cells_array, int section, int cell) {
-/*
- * Set up two arrays, one with section values that exist in the same row as
- * the section,cell passed, the other with the cells.
- *
- */
-
-if (section > 9 || section < 1 || cell > 9 || cell < 1) {
-printf("called at (%d, %d)\n",section, cell);
-}
-  if (section%3 == section || section == 3) {
-    *sections_array++ = 1;
-    *sections_array++ = 2;
-    *sections_array++ = 3;
 
-  } else if (section%6 == section || section == 6) {
-    *sections_array++ = 4;
-    *sections_array++ = 5;
-    *sections_array++ = 6;
-
-  } else {
-    *sections_array++ = 7;
-    *sections_array++ = 8;
-    *sections_array++ = 9;
+ /* Find units that are missing numbers due to constraints */
+  for (u=0; u<unit_count; u++) {
+    available = 0;
+    for (j=0; j<9; j++) {
+      available |= mask[ units[u][j].section ][ units[u][j].cell ];
+    }
+    if (available != 0x3FE) {	/* some value not available in the unit */
+      return(1);
+    }
   }
 
-  if (cell%3 == cell || cell == 3) {
-    *cells_array++ = 1;
-    *cells_array++ = 2;
-    *cells_array++ = 3;
-
-  } else if (cell%6 == cell || cell == 6) {
-    *cells_array++ = 4;
-    *cells_array++ = 5;
-    *cells_array++ = 6;
-
-  } else {
-    *cells_array++ = 7;
-    *cells_array++ = 8;
-    *cells_array++ = 9;
+  if (killer_cage_count != 0) {
+    return(checkCages(board));
   }
-
-}
-
-void determineCol(int *sections_array, int *cells_array, int section, int cell) {
-/*
- * Set up two arrays, one with section values that exist in the same column as
- * the section,cell passed, the other with the cells.
- *
- */
-
-if (section > 9 || section < 1 || cell > 9 || cell < 1) {
-printf("called at (%d, %d)\n",section, cell);
+  return(0);
 }
-  if (section%3 == section || section == 3) {
-    *sections_array++ = section;
-    *sections_array++ = section+3;
-    *sections_array++ = section+6;
-
-  } else if (section%6 == section || section == 6) {
-    *sections_array++ = section-3;
-    *sections_array++ = section;
-    *sections_array++ = section+3;
-
-  } else {
-    *sections_array++ = section-6;
-    *sections_array++ = section-3;
-    *sections_array++ = section;
 
-  }
-
-  if (cell%3 == cell || cell == 3) {
-    *cells_array++ = cell;
-    *cells_array++ = cell+3;
-    *cells_array++ = cell+6;
+unsigned int constraintConflict (SuDoku *board, board_constraint *constraint) {
+  int u,j,k,value,available;
 
-  } else if (cell%6 == cell || cell == 6) {
-    *cells_array++ = cell-3;
-    *cells_array++ = cell;
-    *cells_array++ = cell+3;
+  for (u=0; u<unit_count; u++) {
+    available = 0;
+    for (j=0; j<9; j++) {
+      value = board->section[ units[u][j].section ].cell[ units[u][j].cell ];
+      if (value != 0) {
+        available |= 1 << value;
+        continue;
+      }
+      if (constraint->candidates[ units[u][j].section ][ units[u][j].cell ] == 0) {
+        return(cellWhy(constraint, units[u][j].section, units[u][j].cell));
+      }
+      for (k=1; k<=9; k++) {
+        if (constraint->section[ units[u][j].section ].cell[ units[u][j].cell ].value[k] == 1) { available |= 1 << k; }
+      }
+    }
 
-  } else {
-    *cells_array++ = cell-6;
-    *cells_array++ = cell-3;
-    *cells_array++ = cell;
+   /* A number with no place left, because every cell lost it or holds another */
+    for (k=1; k<=9; k++) {
+      if ((available & (1 << k)) == 0) {
+        for (j=0; j<9; j++) {
+          value = board->section[ units[u][j].section ].cell[ units[u][j].cell ];
+          if (value != 0 && constraint->candidates[ units[u][j].section ][ units[u][j].cell ] != CELL_PLACED) {
+            return(levelsUpTo(constraint->depth));
+          }
+        }
+        return(unitWhy(constraint, u, 0));
+      }
+    }
   }
 
+  return(levelsUpTo(constraint->depth));
 }
 
-int checkRowCol(SuDoku *board, int section, int cell) {
+int cellIndex(int section, int cell) {
 /*
- * This function check one cell to determine if the column and row it
- * exists on is valid for the solution.  This works on incomplete boards
- * as well.  Empty cells denoted by a zero value.  Nothing is changed on
- * the board.  integer 0 is returned for success, 1 for failure.
+ * Convert a section and cell to a row major index, row * 9 + column.
  *
  */
 
-  c_address rows[9], cols[9], tmpcell;
-  int i,j,k;
-  int sections_row[3], cells_row[3];
-  int sections_col[3], cells_col[3];
-
-  determineRow(&sections_row[0], &cells_row[0], section, cell);
-  determineCol(&sections_col[0], &cells_col[0], section, cell);
-
-  k=0;
-  for (i=0; i<3; i++) {
-    for (j=0; j<3; j++) {
-      tmpcell.section = sections_row[i];
-      tmpcell.cell = cells_row[j];
-      tmpcell.value = board->section[sections_row[i]].cell[cells_row[j]];
-      rows[k] = tmpcell;
-
-      tmpcell.section = sections_col[i];
-      tmpcell.cell = cells_col[j];
-      tmpcell.value = board->section[sections_col[i]].cell[cells_col[j]];
-      cols[k] = tmpcell;
-
-      k++;
-    }
-  }
-
-  for (i=0; i<8; i++) {
-    for (j=i+1; j<9; j++) {
-      if (cols[i].value != 0 && cols[j].value != 0) {
-        if (cols[i].value == cols[j].value) {
-          return(1);
-        }
-      }
-
-      if (rows[i].value != 0 && rows[j].value != 0) {
-        if (rows[i].value == rows[j].value) {
-          return(1);
-        }
-      }
-    }
-  }
-
-  return(0);
+  return((((section-1)/3)*3 + (cell-1)/3) * 9 + ((section-1)%3)*3 + (cell-1)%3);
 }
 
 int oneMoveLeft (SuDoku *board) {
@@ -796,22 +1243,16 @@ int valueCellAvailable(SuDoku *board, c_address curCell, int value) {
  *
  */
 
-  int row_sections[3], row_cells[3];
-  int col_sections[3], col_cells[3];
-  int i,j;
+  c_address *peer;
+  int i;
 
   if (board->section[curCell.section].cell[curCell.cell] != 0) {return(1);}
 
-  if (valueAvailable(board, curCell.section, value) != 0 ) {return(1);}
+  if (unit_count == 0) { loadUnits(); }
 
-  determineRow(&row_sections[0], &row_cells[0], curCell.section, curCell.cell);
-  determineCol(&col_sections[0], &col_cells[0], curCell.section, curCell.cell);
-
-  for (i=0; i<3; i++) {
-    for (j=0; j<3; j++) {
-      if (board->section[row_sections[i]].cell[row_cells[j]] == value) { return(1); }
-      if (board->section[col_sections[i]].cell[col_cells[j]] == value) { return(1); }
-    }
+  for (i=0; i<cell_peer_count[curCell.section][curCell.cell]; i++) {
+    peer = &cell_peers[curCell.section][curCell.cell][i];
+    if (board->section[peer->section].cell[peer->cell] == value) { return(1); }
   }
 
   return(0);